@@ -29,6 +29,21 @@ local UpperBorderTempChange = 0;		// temperature at the upper border changes by
 
 /* -- Globals -- */
 
+// Material classes of the grid cells.
+static const TEMPERATURE_Material_Sky = 0;
+static const TEMPERATURE_Material_Tunnel = 1;
+static const TEMPERATURE_Material_Liquid = 2;
+static const TEMPERATURE_Material_Solid = 3;
+
+// The grid is updated in square tiles of this many cells.
+static const TEMPERATURE_Tile_Size = 8;
+// Tiles that sleep are updated only every this many updates.
+static const TEMPERATURE_Tile_SleepInterval = 10;
+// Tiles stay awake for this many updates after the landscape or a temperature was changed.
+static const TEMPERATURE_Tile_WakeUpdates = 15;
+// Tiles go to sleep if no cell changed more than this, in 1e-2 degrees Celsius.
+static const TEMPERATURE_Tile_SteadyChange = 2;
+
 global func GetTemperatureAt(int x, int y, int prec)
 {
 	if (GetType(this) == C4V_C4Object)
@@ -40,7 +55,7 @@ global func GetTemperatureAt(int x, int y, int prec)
 	var control = Temperature->GetTemperatureControl();
 	AssertNotNil(control);
 
-	return control->Point(x, y)->GetTemp(prec);
+	return control->GetTemp(control->GetIndex(x, y), prec);
 }
 
 global func SetTemperatureAt(int x, int y, int amount)
@@ -54,7 +69,7 @@ global func SetTemperatureAt(int x, int y, int amount)
 	var control = Temperature->GetTemperatureControl();
 	AssertNotNil(control);
 
-	control->Point(x, y)->SetTemp(amount);
+	control->SetTemp(control->GetIndex(x, y), amount);
 }
 
 /* -- Public interface -- */
@@ -102,6 +117,42 @@ public func GetMaterialChangeSpeed(int material)
 }
 
 
+/**
+	Gets the material class of a position, one of TEMPERATURE_Material_*.
+ */
+public func GetMaterialClass(int x, int y)
+{
+	if (GBackSolid(x, y))
+	{
+		return TEMPERATURE_Material_Solid;
+	}
+	else if (GBackLiquid(x, y))
+	{
+		return TEMPERATURE_Material_Liquid;
+	}
+	else if (GBackSky(x, y))
+	{
+		return TEMPERATURE_Material_Sky;
+	}
+	return TEMPERATURE_Material_Tunnel;
+}
+
+
+/**
+	Tells the temperature grid that the landscape changed in a rectangle,
+	in global coordinates. The cells in that rectangle sample their material
+	again in the next update.
+ */
+public func OnLandscapeChange(int x, int y, int wdt, int hgt)
+{
+	var control = GetTemperatureControl();
+	if (control)
+	{
+		control->MarkLandscapeChange(x, y, wdt, hgt);
+	}
+}
+
+
 /* -- Internals -- */
 
 func GetTemperatureControl(bool create_if_necessary)
@@ -115,80 +166,62 @@ func GetTemperatureControl(bool create_if_necessary)
 }
 
 
+// Gets the material at a position, mirrored at the landscape borders.
+func GetMirroredMaterial(int x, int y)
+{
+	if (x < 0)
+	{
+		x *= -1;
+	}
+	if (x > LandscapeWidth())
+	{
+		x = 2 * LandscapeWidth() - x;
+	}
+	if (y < 0)
+	{
+		y *= -1;
+	}
+	if (y > LandscapeHeight())
+	{
+		y = 2 * LandscapeHeight() - y;
+	}
+	return GetMaterial(x, y);
+}
+
+
+/**
+	View of a single grid cell, as returned by Point(). The values are
+	stored in the arrays of the temperature control, not in the view.
+ */
 static const TemperaturePoint = new Global
 {
-	Temp = 0,	// base temperature, in precision 100 (= 0.01 degrees)
-	Speed = 1000,		// speed adjustment
+	Control = nil,		// the temperature control
+	Index = 0,			// index of the cell in the grid arrays
 	X = 0,				// position, in global coordinates, precision 1
 	Y = 0,				// position, in global coordinates, precision 1
 
-	SetPosition = func (int x, int y)
-	{
-		this.X = x;
-		this.Y = y;
-		return this;
-	},
-
 	SetTemp = func (int amount)
 	{
-		if (amount)
-		{
-			this.Temp = BoundBy(amount, Temperature.MinTemperature, Temperature.MaxTemperature);
-		}
-		else
-		{		
-			var material = GetMat(this.X, this.Y);
-			var temperature = Temperature->GetMaterialTemperature(material);
-			if (temperature) SetTemp(temperature);
-		}
+		this.Control->SetTemp(this.Index, amount);
 		return this;
 	},
 
 	GetTemp = func(int prec)
 	{
-		return this.Temp * (prec ?? 1) / 100;
+		return this.Control->GetTemp(this.Index, prec);
 	},
 
 	ChangeTemp = func (int amount)
 	{
-		SetTemp(this.Temp + amount * this.Speed  / 1000);
+		this.Control->ChangeTemp(this.Index, amount);
+		return this;
 	},
 
 	SetChangeSpeed = func (int amount)
 	{
-		if (amount)
-		{
-			this.Speed = BoundBy(amount, 0, 1000);
-		}
-		else
-		{
-			var material = GetMat(this.X, this.Y);
-			var speed = Temperature->GetMaterialChangeSpeed(material);
-			if (speed) SetChangeSpeed(speed);
-		}
+		this.Control->SetChangeSpeed(this.Index, amount);
 		return this;
 	},
-
-	GetMat = func (int x, int y)
-	{
-		if (x < 0)
-		{
-			x *= -1;
-		}
-		if (x > LandscapeWidth())
-		{
-			x = 2 * LandscapeWidth() - x;
-		}
-		if (y < 0)
-		{
-			y *= -1;
-		}
-		if (y > LandscapeHeight())
-		{
-			y = 2 * LandscapeHeight() - y;
-		}
-		return GetMaterial(x, y);
-	},
 };
 
 
@@ -198,7 +231,25 @@ local FxTemperatureControl = new Effect
 	{
 		// set values
 		this.grid_distance = 10;
-		this.grid = [];
+		this.grid_width = 0;		// number of cells in x direction
+		this.grid_height = 0;		// number of cells in y direction
+		this.temp = [];				// temperature per cell, in 1e-2 degrees Celsius; cell (x, y) is at index x * grid_height + y
+		this.speed = [];			// change speed per cell, in 1e-3
+		this.material = [];			// material class per cell, see TEMPERATURE_Material_*
+		this.temp_buffer = [];		// diffusion writes the new temperatures here, before copying them to this.temp
+		this.material_changed = [];	// true for cells that have to sample their material again
+		this.changed_cells = [];	// indices of the cells that have to sample their material again
+		this.resample_column = 0;	// next column that samples its material again anyway
+		this.sun_exposure = [];		// per cell, DistanceSunlight minus the distance to the next sky pixel above, at least 0
+		this.sun_changed = [];		// true for columns that have to update their sun exposure
+		this.changed_columns = [];	// indices of the columns that have to update their sun exposure
+		this.tiles_height = 0;		// number of tiles in y direction; tile (x, y) is at index x * tiles_height + y
+		this.tile_count = 0;
+		this.tile_awake_until = [];	// per tile, the tile is awake until this update
+		this.tile_steady = [];		// per tile, true if the tile barely changed in its last update
+		this.tile_change = [];		// per tile, the largest change of a cell in its last update, in 1e-2 degrees Celsius
+		this.update_tiles = [];		// tiles that are updated in the current update
+		this.update_count = 0;		// number of updates so far
 		this.debug = false;
 		this.temperature = GetTemperature();
 
@@ -213,41 +264,31 @@ local FxTemperatureControl = new Effect
 	{
 		// difference
 		this.temperature = GetTemperature();
-	
-		// iterate over all points
-		for (var column in this.grid)
-		for (var point in column)
+
+		// material of changed cells
+		UpdateChangedCells();
+
+		// awake tiles, and the sleeping tiles whose turn it is
+		this.update_count += 1;
+		WakeTilesNearObjects();
+		var tiles = GetTilesToUpdate();
+
+		// calculate the change
+		for (var tile in tiles)
 		{
-			// calculate the change
-			var change = 0;
-			change = Temperature->CalcTempChange_Planet(point, change);
-			change = Temperature->CalcTempChange_Season(point, change, this.temperature);
-			change = Temperature->CalcTempChange_Sun(point, change);
-			change = Temperature->CalcTempChange_LowerBorder(point, change);
-			change = Temperature->CalcTempChange_UpperBorder(point, change);
-			point->ChangeTemp(change);
+			UpdateTile(tile);
 		}
-	
-	
-		var prec = 100;
-		// influence neighbors, update graphics
-		var width = GetLength(this.grid);
-		for (var x = 0; x < width; ++x)
+
+		// influence neighbors
+		Diffuse(tiles);
+
+		// display the temperature in debug mode
+		if (this.debug)
 		{
-			var height = GetLength(this.grid[x]);
-			for (var y = 0; y < height; ++y)
+			for (var index = 0; index < this.grid_width * this.grid_height; ++index)
 			{
-				var point = this.grid[x][y];
-				var temperature = CalcAverageTemperature(x, y, prec);
-				point->ChangeTemp(temperature - point->GetTemp(prec));
-			
-				// display the temperature in debug mode
-				var temp = BoundBy(point->GetTemp(), -60, 128);
-				if (this.debug)
-				{
-					var hue = 128 - temp;
-					CreateParticle("Magic", point.X, point.Y, 0, 0, this.Interval, { Prototype = Particles_Colored(Particles_Trajectory(), HSL2RGB(RGB(hue, 255, 128))), Size = this.grid_distance * 2, Alpha = 50});
-				}
+				var hue = 128 - BoundBy(GetTemp(index), -60, 128);
+				CreateParticle("Magic", GetCellX(index), GetCellY(index), 0, 0, this.Interval, { Prototype = Particles_Colored(Particles_Trajectory(), HSL2RGB(RGB(hue, 255, 128))), Size = this.grid_distance * 2, Alpha = 50});
 			}
 		}
 	},
@@ -256,105 +297,398 @@ local FxTemperatureControl = new Effect
 	{
 		Log("Creating temperature grid");
 		this.grid_distance = Max(1, sample_distance ?? 10);
-		var amount_x = 2 + LandscapeWidth() / this.grid_distance;
-		var amount_y = 2 + LandscapeHeight() / this.grid_distance;
+		this.grid_width = 2 + LandscapeWidth() / this.grid_distance;
+		this.grid_height = 2 + LandscapeHeight() / this.grid_distance;
+
+		var size = this.grid_width * this.grid_height;
+		this.temp = CreateArray(size);
+		this.speed = CreateArray(size);
+		this.material = CreateArray(size);
+		this.temp_buffer = CreateArray(size);
+		this.material_changed = CreateArray(size);
+		this.changed_cells = [];
+		this.resample_column = 0;
+		this.sun_exposure = CreateArray(size);
+		this.sun_changed = CreateArray(this.grid_width);
+		this.changed_columns = [];
+
+		this.tiles_height = (this.grid_height + TEMPERATURE_Tile_Size - 1) / TEMPERATURE_Tile_Size;
+		this.tile_count = this.tiles_height * ((this.grid_width + TEMPERATURE_Tile_Size - 1) / TEMPERATURE_Tile_Size);
+		this.tile_awake_until = CreateArray(this.tile_count);
+		this.tile_steady = CreateArray(this.tile_count);
+		this.tile_change = CreateArray(this.tile_count);
+		for (var tile = 0; tile < this.tile_count; ++tile)
+		{
+			this.tile_awake_until[tile] = 0;
+			this.tile_steady[tile] = false;
+			this.tile_change[tile] = 0;
+		}
+
+		for (var index = 0; index < size; ++index)
+		{
+			this.temp[index] = 0;
+			this.speed[index] = 1000;
+			SetTemp(index);
+			SampleMaterial(index);
+		}
+		for (var index_x = 0; index_x < this.grid_width; ++index_x)
+		{
+			UpdateSunExposure(index_x);
+		}
+	},
 
-		for (var x = 0; x < amount_x; ++x)
+	// Samples the material class and change speed of a cell, and wakes its tile if the class changed.
+	SampleMaterial = func (int index)
+	{
+		var material = Temperature->GetMaterialClass(GetCellX(index), GetCellY(index));
+		if (this.material[index] != nil && this.material[index] != material)
 		{
-			this.grid[x] = [];
-			for (var y = 0; y < amount_y; ++y)
+			WakeTiles(GetCellX(index), GetCellY(index), 0, 0, TEMPERATURE_Tile_WakeUpdates);
+		}
+		this.material[index] = material;
+		SetChangeSpeed(index);
+	},
+
+	// Remembers the cells in a rectangle, in global coordinates, for sampling their material again.
+	MarkLandscapeChange = func (int x, int y, int wdt, int hgt)
+	{
+		if (this.grid_width == 0)
+		{
+			return;
+		}
+		WakeTiles(x, y, wdt, hgt, TEMPERATURE_Tile_WakeUpdates);
+
+		var height = this.grid_height;
+		var from = GetIndex(x, y);
+		var to = GetIndex(x + wdt + this.grid_distance - 1, y + hgt + this.grid_distance - 1);
+		var from_x = from / height;
+		var from_y = from % height;
+		var to_x = to / height;
+		var to_y = to % height;
+		for (var index_x = from_x; index_x <= to_x; ++index_x)
+		{
+			if (!this.sun_changed[index_x])
 			{
-				this.grid[x][y] = new TemperaturePoint {};
-			
-				var global_x = (x - 1) * this.grid_distance;
-				var global_y = (y - 1) * this.grid_distance;
-
-				this.grid[x][y]->SetPosition(global_x, global_y)
-				               ->SetTemp()
-				               ->SetChangeSpeed();
+				this.sun_changed[index_x] = true;
+				PushBack(this.changed_columns, index_x);
+			}
+			for (var index_y = from_y; index_y <= to_y; ++index_y)
+			{
+				var index = index_x * height + index_y;
+				if (!this.material_changed[index])
+				{
+					this.material_changed[index] = true;
+					PushBack(this.changed_cells, index);
+				}
 			}
 		}
 	},
 
+	// Samples the material of the changed cells again. The landscape also
+	// changes without notice, for example when liquids flow or a clonk digs,
+	// so one column samples its material again anyway on every update.
+	UpdateChangedCells = func ()
+	{
+		if (this.grid_width == 0)
+		{
+			return;
+		}
+		for (var index in this.changed_cells)
+		{
+			this.material_changed[index] = false;
+			SampleMaterial(index);
+		}
+		SetLength(this.changed_cells, 0);
+
+		for (var index_x in this.changed_columns)
+		{
+			this.sun_changed[index_x] = false;
+			UpdateSunExposure(index_x);
+		}
+		SetLength(this.changed_columns, 0);
+
+		var column = this.resample_column * this.grid_height;
+		for (var index = column; index < column + this.grid_height; ++index)
+		{
+			SampleMaterial(index);
+		}
+		UpdateSunExposure(this.resample_column);
+		this.resample_column = (this.resample_column + 1) % this.grid_width;
+	},
+
+	// Updates the sun exposure of the cells in a column. Scans the column once
+	// from top to bottom, remembering the last sky pixel, instead of searching
+	// upwards from every cell.
+	UpdateSunExposure = func (int index_x)
+	{
+		var height = this.grid_height;
+		var distance_sunlight = Temperature.DistanceSunlight;
+		var column = index_x * height;
+		var x = GetCellX(column);
+		var y = GetCellY(column) - distance_sunlight;
+		var last_sky = nil;
+		for (var index = column; index < column + height; ++index)
+		{
+			var cell_y = GetCellY(index);
+			// pixels further up do not matter, if the cells are far apart
+			y = Max(y, cell_y - distance_sunlight);
+			for (; y <= cell_y; ++y)
+			{
+				if (GBackSky(x, y))
+				{
+					last_sky = y;
+				}
+			}
+
+			var exposure = 0;
+			if (last_sky != nil)
+			{
+				exposure = Max(0, distance_sunlight - (cell_y - last_sky));
+			}
+			this.sun_exposure[index] = exposure;
+		}
+	},
+
 	Point = func (int x, int y)
+	{
+		var index = GetIndex(x, y);
+		return new TemperaturePoint { Control = this, Index = index, X = GetCellX(index), Y = GetCellY(index) };
+	},
+
+	// Gets the index of the cell at a position, in global coordinates.
+	GetIndex = func (int x, int y)
 	{
 		x = BoundBy(x, -this.grid_distance, LandscapeWidth() + this.grid_distance);
 		y = BoundBy(y, -this.grid_distance, LandscapeHeight() + this.grid_distance);
-		var index_x = 1 + x / this.grid_distance;
-		var index_y = 1 + y / this.grid_distance;
-	
-		return this.grid[index_x][index_y];
+		var index_x = BoundBy(1 + x / this.grid_distance, 0, this.grid_width - 1);
+		var index_y = BoundBy(1 + y / this.grid_distance, 0, this.grid_height - 1);
+		return index_x * this.grid_height + index_y;
+	},
+
+	// Gets the position of a cell, in global coordinates.
+	GetCellX = func (int index)
+	{
+		return (index / this.grid_height - 1) * this.grid_distance;
 	},
 
-	CalcAverageTemperature = func(int index_x, int index_y, int prec)
+	GetCellY = func (int index)
 	{
-		var center = this.grid[index_x][index_y];
-		var samples = [center, center]; // center has double weight
-	
-		// left side
-		if (index_x > 0)
+		return (index % this.grid_height - 1) * this.grid_distance;
+	},
+
+	SetTemp = func (int index, int amount)
+	{
+		if (amount)
 		{
-			PushBack(samples, this.grid[index_x-1][index_y]);
+			this.temp[index] = BoundBy(amount, Temperature.MinTemperature, Temperature.MaxTemperature);
+			WakeTiles(GetCellX(index), GetCellY(index), 0, 0, TEMPERATURE_Tile_WakeUpdates);
 		}
 		else
 		{
-			PushBack(samples, center);
+			var material = Temperature->GetMirroredMaterial(GetCellX(index), GetCellY(index));
+			var temperature = Temperature->GetMaterialTemperature(material);
+			if (temperature) SetTemp(index, temperature);
 		}
-	
-		// right side
-		if (index_x == GetLength(this.grid) - 1)
+	},
+
+	GetTemp = func (int index, int prec)
+	{
+		return this.temp[index] * (prec ?? 1) / 100;
+	},
+
+	ChangeTemp = func (int index, int amount)
+	{
+		SetTemp(index, this.temp[index] + amount * this.speed[index] / 1000);
+	},
+
+	SetChangeSpeed = func (int index, int amount)
+	{
+		if (amount)
 		{
-			PushBack(samples, center);
+			this.speed[index] = BoundBy(amount, 0, 1000);
 		}
 		else
 		{
-			PushBack(samples, this.grid[index_x + 1][index_y]);
+			var material = Temperature->GetMirroredMaterial(GetCellX(index), GetCellY(index));
+			var speed = Temperature->GetMaterialChangeSpeed(material);
+			if (speed) SetChangeSpeed(index, speed);
 		}
-	
-		// top side
-		if (index_y > 0)
+	},
+
+	// Gets the cells of a tile, as [from_x, to_x, from_y, to_y], with to_x and to_y exclusive.
+	GetTileCells = func (int tile)
+	{
+		var from_x = (tile / this.tiles_height) * TEMPERATURE_Tile_Size;
+		var from_y = (tile % this.tiles_height) * TEMPERATURE_Tile_Size;
+		return [from_x, Min(from_x + TEMPERATURE_Tile_Size, this.grid_width), from_y, Min(from_y + TEMPERATURE_Tile_Size, this.grid_height)];
+	},
+
+	// Wakes the tiles in a rectangle, in global coordinates, for this many updates.
+	WakeTiles = func (int x, int y, int wdt, int hgt, int updates)
+	{
+		if (this.tile_count == 0)
 		{
-			PushBack(samples, this.grid[index_x][index_y-1]);
+			return;
 		}
-		else
+		var height = this.grid_height;
+		var from = GetIndex(x, y);
+		var to = GetIndex(x + wdt, y + hgt);
+		var awake_until = this.update_count + updates;
+		for (var tile_x = (from / height) / TEMPERATURE_Tile_Size; tile_x <= (to / height) / TEMPERATURE_Tile_Size; ++tile_x)
 		{
-			PushBack(samples, center);
+			for (var tile_y = (from % height) / TEMPERATURE_Tile_Size; tile_y <= (to % height) / TEMPERATURE_Tile_Size; ++tile_y)
+			{
+				var tile = tile_x * this.tiles_height + tile_y;
+				this.tile_awake_until[tile] = Max(this.tile_awake_until[tile], awake_until);
+			}
 		}
-	
-		// bottom side
-		if (index_y == GetLength(this.grid[0]) - 1)
+	},
+
+	// Keeps the tiles around crew members, structures and burning objects awake.
+	WakeTilesNearObjects = func ()
+	{
+		if (this.tile_count == 0)
 		{
-			PushBack(samples, center);
+			return;
 		}
-		else
+		var range = TEMPERATURE_Tile_Size * this.grid_distance;
+		for (var obj in FindObjects(Find_Or(Find_OCF(OCF_CrewMember), Find_Category(C4D_Structure), Find_OCF(OCF_OnFire))))
+		{
+			WakeTiles(obj->GetX() - range, obj->GetY() - range, 2 * range, 2 * range, 0);
+		}
+	},
+
+	// Gets the tiles that are awake, and the sleeping tiles that are updated
+	// in this update. Sleeping tiles take turns, so that they do not all update
+	// at the same time.
+	GetTilesToUpdate = func ()
+	{
+		var tiles = this.update_tiles;
+		SetLength(tiles, 0);
+		for (var tile = 0; tile < this.tile_count; ++tile)
+		{
+			if (this.tile_awake_until[tile] >= this.update_count
+			 || !this.tile_steady[tile]
+			 || (this.update_count + tile) % TEMPERATURE_Tile_SleepInterval == 0)
+			{
+				PushBack(tiles, tile);
+			}
+		}
+		return tiles;
+	},
+
+	// Applies the temperature change of the planet, season, sun and borders to the cells of a tile.
+	UpdateTile = func (int tile)
+	{
+		var cells = GetTileCells(tile);
+		var height = this.grid_height;
+		var distance = this.grid_distance;
+		var temp = this.temp;
+		var speed = this.speed;
+		var material = this.material;
+		var sun_exposure = this.sun_exposure;
+		var temperature = this.temperature;
+		var brightness = GetAmbientBrightness();
+		var min = Temperature.MinTemperature;
+		var max = Temperature.MaxTemperature;
+		var largest_change = 0;
+
+		for (var x = cells[0]; x < cells[1]; ++x)
 		{
-			PushBack(samples, this.grid[index_x][index_y+1]);
+			var global_x = (x - 1) * distance;
+			for (var y = cells[2]; y < cells[3]; ++y)
+			{
+				var global_y = (y - 1) * distance;
+				var index = x * height + y;
+
+				var change = 0;
+				change = Temperature->CalcTempChange_Planet(material[index], change);
+				change = Temperature->CalcTempChange_Season(material[index], temp[index], change, temperature);
+				change = Temperature->CalcTempChange_Sun(material[index], sun_exposure[index], change, brightness);
+				change = Temperature->CalcTempChange_LowerBorder(global_x, global_y, change);
+				change = Temperature->CalcTempChange_UpperBorder(global_x, global_y, change);
+
+				var previous = temp[index];
+				temp[index] = BoundBy(previous + change * speed[index] / 1000, min, max);
+				largest_change = Max(largest_change, Abs(temp[index] - previous));
+			}
 		}
-	
-		// calculation
-		var average = 0;
-		for (var sample in samples)
+		this.tile_change[tile] = largest_change;
+	},
+
+	// Averages each cell with its four neighbors, the cell itself has double weight.
+	// Reads only from this.temp and writes only to this.temp_buffer, so that the
+	// result does not depend on the iteration order; the results are copied to
+	// this.temp afterwards. Cells at the border of a tile read their neighbors
+	// in the next tile, even if that tile sleeps. Cells at the grid border use
+	// their own temperature in place of the missing neighbor.
+	Diffuse = func (array tiles)
+	{
+		var width = this.grid_width;
+		var height = this.grid_height;
+		var temp = this.temp;
+		var buffer = this.temp_buffer;
+		var speed = this.speed;
+
+		for (var tile in tiles)
 		{
-			average += sample->GetTemp(prec);
+			var cells = GetTileCells(tile);
+			for (var x = cells[0]; x < cells[1]; ++x)
+			{
+				var column = x * height;
+				var left = column - height;
+				var right = column + height;
+				if (x == 0) left = column;
+				if (x == width - 1) right = column;
+
+				for (var y = cells[2]; y < cells[3]; ++y)
+				{
+					var index = column + y;
+					var center = temp[index];
+					var top = center;
+					var bottom = center;
+					if (y > 0) top = temp[index - 1];
+					if (y < height - 1) bottom = temp[index + 1];
+
+					var average = (2 * center + temp[left + y] + temp[right + y] + top + bottom) / 6;
+					buffer[index] = center + (average - center) * speed[index] / 1000;
+				}
+			}
+		}
+
+		// copy the results, tiles that barely changed go to sleep
+		for (var tile in tiles)
+		{
+			var cells = GetTileCells(tile);
+			var largest_change = 0;
+			for (var x = cells[0]; x < cells[1]; ++x)
+			{
+				for (var y = cells[2]; y < cells[3]; ++y)
+				{
+					var index = x * height + y;
+					largest_change = Max(largest_change, Abs(buffer[index] - temp[index]));
+					temp[index] = buffer[index];
+				}
+			}
+			this.tile_change[tile] += largest_change;
+			this.tile_steady[tile] = this.tile_change[tile] <= TEMPERATURE_Tile_SteadyChange;
 		}
-		average /= GetLength(samples);
-		return average;
 	},
 };
 
 /* -- Calculations -- */
 
-func CalcTempChange_Planet(proplist point, int change)
+func CalcTempChange_Planet(int material, int change)
 {
-	if (GBackSolid(point.X, point.Y))
+	if (material == TEMPERATURE_Material_Solid)
 	{
 		if (PlanetTempChangeSolid) return CalcTempChange(PlanetTempChangeSolid);
 	}
-	else if (GBackLiquid(point.X, point.Y))
+	else if (material == TEMPERATURE_Material_Liquid)
 	{
 		if (PlanetTempChangeLiquid) return CalcTempChange(PlanetTempChangeLiquid);
 	}
-	else if (GBackSky(point.X, point.Y))
+	else if (material == TEMPERATURE_Material_Sky)
 	{
 		if (PlanetTempChangeSky) return CalcTempChange(PlanetTempChangeSky);
 	}
@@ -363,23 +697,12 @@ func CalcTempChange_Planet(proplist point, int change)
 }
 
 
-func CalcTempChange_Sun(proplist point, int change)
+func CalcTempChange_Sun(int material, int exposure, int change, int brightness)
 {
-	if (GBackSolid(point.X, point.Y))
+	if (material == TEMPERATURE_Material_Solid)
 	{
-		var distance_sky = 0;
-		var sunlight = 0;
-		for (; distance_sky < DistanceSunlight; ++distance_sky)
-		{
-			if (GBackSky(point.X, point.Y - distance_sky))
-			{
-				var relative = DistanceSunlight - distance_sky;
-				var intensity = GetAmbientBrightness() * 7 / 4;
-				sunlight = relative * intensity / DistanceSunlight;
-				break;
-			}
-		}
-	
+		var intensity = brightness * 7 / 4;
+		var sunlight = exposure * intensity / DistanceSunlight;
 		return BoundBy(change + sunlight, PlanetMinTemperature, PlanetMaxTemperature);
 	}
 
@@ -387,15 +710,15 @@ func CalcTempChange_Sun(proplist point, int change)
 }
 
 
-func CalcTempChange_Season(proplist point, int change, int temperature)
+func CalcTempChange_Season(int material, int temp, int change, int temperature)
 {
-	if (GBackSky(point.X, point.Y))
+	if (material == TEMPERATURE_Material_Sky)
 	{
 		// sky temperature should be approximately the atmospheric temperature
 		// this could also be solved by light intensity stuff, but it is not done
 		// like that yet
 		var prec = 100;
-		var diff = temperature * prec - point->GetTemp(prec);
+		var diff = temperature * prec - temp;
 		return BoundBy(change + diff, PlanetMinTemperature, PlanetMaxTemperature);
 	}
 
@@ -403,11 +726,11 @@ func CalcTempChange_Season(proplist point, int change, int temperature)
 }
 
 
-func CalcTempChange_LowerBorder(proplist point, int change)
+func CalcTempChange_LowerBorder(int x, int y, int change)
 {
 	if (LowerBorderDistance > 0)
 	{
-		var relative =  BoundBy(point.Y - LandscapeHeight() + LowerBorderDistance, 0, LowerBorderDistance);
+		var relative =  BoundBy(y - LandscapeHeight() + LowerBorderDistance, 0, LowerBorderDistance);
 		var diff = relative * LowerBorderTempChange / LowerBorderDistance;
 		return BoundBy(change + diff, PlanetMinTemperature, PlanetMaxTemperature);
 	}
@@ -416,11 +739,11 @@ func CalcTempChange_LowerBorder(proplist point, int change)
 }
 
 
-func CalcTempChange_UpperBorder(proplist point, int change)
+func CalcTempChange_UpperBorder(int x, int y, int change)
 {
 	if (UpperBorderDistance > 0)
 	{
-		var relative =  BoundBy(UpperBorderDistance - point.Y, 0, UpperBorderDistance);
+		var relative =  BoundBy(UpperBorderDistance - y, 0, UpperBorderDistance);
 		var diff = relative * CalcTempChange(UpperBorderTempChange) / UpperBorderDistance;
 		return BoundBy(change + diff, PlanetMinTemperature, PlanetMaxTemperature);
 	}
@@ -6,6 +6,9 @@
 
 local pipe_kit;
 
+// A static variable that holds the power lines attached to each object, by object number.
+static POWER_LINE_ENDPOINTS;
+
 /* -- Engine callbacks -- */
 
 
@@ -14,15 +17,17 @@ func Construction()
 	// Initialize the single proplist for the library.
 	if (lib_linked == nil)
 		lib_linked = {};
-	// Set some default variables.
-	lib_linked.linked_objects = [];
+	// Set some default variables: the line is not linked to other lines yet.
+	lib_linked.line_component = [this];
 	return _inherited(...);
 }
 
 
 func Destruction()
 {
-	PowerLine->RefreshAllLineNetworks();
+	RemoveLineEndsFromIndex();
+	RefreshLineEnds();
+	DetachFromLineComponent();
 	if (GetActionTarget(0)) GetActionTarget(0)->~OnLineLineRemoval();
 	if (GetActionTarget(1)) GetActionTarget(1)->~OnLineLineRemoval();
 	return _inherited(...);
@@ -62,6 +67,23 @@ public func IsConnectedTo(object obj, bool strict)
 }
 
 
+// The index of attached lines must follow the action targets.
+public func SetAction(string action, object target0, object target1)
+{
+	var result = _inherited(action, target0, target1, ...);
+	AddLineEndsToIndex();
+	return result;
+}
+
+
+public func SetActionTargets(object target0, object target1)
+{
+	var result = _inherited(target0, target1, ...);
+	AddLineEndsToIndex();
+	return result;
+}
+
+
 // Returns the object which is connected to obj through this power line.
 public func GetConnectedObject(object obj)
 {
@@ -78,12 +100,19 @@ public func SwitchConnection(object connected_to, object obj)
 {
 	var target0 = GetActionTarget(0), target1 = GetActionTarget(1);
 
+	// The previous end has to be refreshed as well, it may not be connected anymore.
+	RefreshLineEnds();
+	// The line leaves its component as if it was removed, the previous end may have been the only connection.
+	var remaining_lines = SplitLineComponent();
 	if (target0 == connected_to) target0 = obj;
 	if (target1 == connected_to) target1 = obj;
 
 	SetActionTargets(target0, target1);
 
-	PowerLine->RefreshAllLineNetworks();
+	// Then it joins the components at its new ends.
+	JoinLineComponents(GetLength(remaining_lines) > 0);
+	// The new end may join the network, even if the component keeps its helper.
+	RefreshLineEnds();
 }
 
 
@@ -91,6 +120,7 @@ public func SwitchConnection(object connected_to, object obj)
 public func SetLineKit(object obj)
 {
 	pipe_kit = obj;
+	AddLineEndsToIndex();
 }
 
 
@@ -121,7 +151,9 @@ func OnLineBreak(bool no_msg)
 		if (GetActionTarget(1)) GetActionTarget(1)->~OnLineDisconnect(GetLineKit());
 	}
 
-	PowerLine->RefreshAllLineNetworks();
+	RemoveLineEndsFromIndex();
+	RefreshLineEnds();
+	DetachFromLineComponent();
 	return;
 }
 
@@ -154,6 +186,86 @@ public func GetLineLength()
 }
 
 
+/* -- Line index -- */
+
+// Definition call: returns the power lines attached to an object, in O(degree) instead of searching all objects.
+// This includes the lines for which the object is the line kit, like IsConnectedTo() does.
+public func GetAttachedLines(object obj)
+{
+	if (GetType(POWER_LINE_ENDPOINTS) != C4V_PropList)
+	{
+		RebuildLineIndex();
+	}
+	if (!obj)
+		return [];
+	return POWER_LINE_ENDPOINTS[Format("%d", obj->ObjectNumber())] ?? [];
+}
+
+
+// Definition call: builds the index from all existing power lines, for example after loading a scenario.
+// Uses the same test as RefreshAllLineNetworks(), so that lines which derive from this one are indexed, too.
+func RebuildLineIndex()
+{
+	POWER_LINE_ENDPOINTS = {};
+	for (var line in FindObjects(Find_Func("IsPowerLine")))
+	{
+		line->~AddLineEndsToIndex();
+	}
+}
+
+
+// Updates the index for the current action targets and the line kit of this line.
+func AddLineEndsToIndex()
+{
+	RemoveLineEndsFromIndex();
+	if (GetType(POWER_LINE_ENDPOINTS) != C4V_PropList)
+	{
+		// The rebuild adds this line as well.
+		return RebuildLineIndex();
+	}
+	var keys = [];
+	for (var end in [GetActionTarget(0), GetActionTarget(1), pipe_kit])
+	{
+		if (!end)
+			continue;
+		var key = Format("%d", end->ObjectNumber());
+		if (GetIndexOf(keys, key) != -1)
+			continue;
+		var lines = POWER_LINE_ENDPOINTS[key];
+		if (!lines)
+		{
+			lines = [];
+			POWER_LINE_ENDPOINTS[key] = lines;
+		}
+		PushBack(lines, this);
+		PushBack(keys, key);
+	}
+	lib_linked.indexed_ends = keys;
+	GetPowerSystem()->InvalidatePowerNetworkCache();
+}
+
+
+// Removes this line from the index. The keys of the ends are remembered, because the action targets may be gone already.
+func RemoveLineEndsFromIndex()
+{
+	if (GetType(POWER_LINE_ENDPOINTS) != C4V_PropList || !lib_linked.indexed_ends)
+		return;
+	for (var key in lib_linked.indexed_ends)
+	{
+		var lines = POWER_LINE_ENDPOINTS[key];
+		if (!lines)
+			continue;
+		var index = GetIndexOf(lines, this);
+		if (index != -1)
+			RemoveArrayIndex(lines, index);
+		if (GetLength(lines) == 0)
+			POWER_LINE_ENDPOINTS[key] = nil;
+	}
+	lib_linked.indexed_ends = nil;
+	GetPowerSystem()->InvalidatePowerNetworkCache();
+}
+
+
 func BreakMessage()
 {
 	var line_end = GetLineKit();
@@ -210,99 +322,336 @@ local lib_linked;
 
 /* -- Library Code -- */
 
-func RefreshAllLineNetworks()
+// Definition call: refreshes the networks of all lines. The lines are grouped into connected components
+// in a single pass and each component gets one network helper. A line that is about to be removed can be
+// excluded, because it is still a functioning line during its destruction.
+func RefreshAllLineNetworks(object removed_line)
 {
 	Log("Refresh all line networks");
-	var all_lines = FindObjects(Find_Func("IsPowerLine"));
+	RefreshLineNetworks(FindObjects(Find_Func("IsPowerLine"), Find_Exclude(removed_line)));
+}
+
+
+// Definition call: groups the given lines into connected components, each component gets one network helper.
+func RefreshLineNetworks(array all_lines)
+{
+	var line_count = GetLength(all_lines);
 
-	for (var line in all_lines)
+	// Build a disjoint-set over the lines: two lines are in the same set if they share an end.
+	var parent = [], size = [];
+	var line_at_end = {};
+	for (var index = 0; index < line_count; index++)
 	{
-		line->RefreshLinkedObjects(all_lines);
+		parent[index] = index;
+		size[index] = 1;
+	}
+	for (var index = 0; index < line_count; index++)
+	{
+		var line = all_lines[index];
+		for (var end in [line->GetActionTarget(0), line->GetActionTarget(1), line.pipe_kit])
+		{
+			if (!end)
+				continue;
+			var key = Format("%d", end->ObjectNumber());
+			if (line_at_end[key] == nil)
+				line_at_end[key] = index;
+			else
+				UnionLineSets(parent, size, line_at_end[key], index);
+		}
 	}
 
-	GetPowerSystem()->RefreshAllPowerNetworks();
+	// Collect the components.
+	var components = [];
+	var component_of_set = [];
+	for (var index = 0; index < line_count; index++)
+	{
+		var root = FindLineSet(parent, index);
+		if (component_of_set[root] == nil)
+		{
+			component_of_set[root] = GetLength(components);
+			PushBack(components, []);
+		}
+		PushBack(components[component_of_set[root]], all_lines[index]);
+	}
+
+	// Each component keeps a helper of one of its lines if possible, so that an unchanged component keeps its network.
+	// Every line whose helper changes marks its old network and its ends for the single refresh in the next frame.
+	var claimed_helpers = {};
+	for (var component in components)
+	{
+		var helper = nil;
+		for (var line in component)
+		{
+			var candidate = line->GetPowerHelper();
+			if (candidate && !claimed_helpers[Format("%d", candidate->ObjectNumber())])
+			{
+				helper = candidate;
+				break;
+			}
+		}
+		if (!helper)
+			helper = GetPowerSystem()->CreateNetwork(false);
+		claimed_helpers[Format("%d", helper->ObjectNumber())] = true;
+		for (var line in component)
+		{
+			line->SetLineComponent(component, helper);
+		}
+	}
+}
+
+
+// Removes this line from its component, because it breaks or is destroyed. Only if the component
+// is split by this, the lines on the detached side get a new network helper.
+func DetachFromLineComponent()
+{
+	if (lib_linked.is_detached)
+		return;
+	lib_linked.is_detached = true;
+	SplitLineComponent();
 }
 
 
-// Refreshes the linked objects for this object and also updates the linked objects of the objects linked to this object.
-// TODO: Maybe there is a need to update the links of the objects which were linked before but are not now.
-func RefreshLinkedObjects(array found_objects)
+// Removes this line from its component and gives the lines on the smaller side a new network helper,
+// if the component is split by this. Returns the lines that remain in the previous component, these
+// keep the helper of this line.
+func SplitLineComponent()
 {
-	// Construct a list fo currently linked objects (to this object).
-	var current_linked_objects = [];
-	// Do this by iterating over all directly linked objects and go outward from this object.
-	var iterate_objects = [this];
-	// Once the list of iterated objects is empty we are done.
-	while (GetLength(iterate_objects))
+	// The component array is shared by all its lines, so it is changed in place.
+	var component = lib_linked.line_component;
+	var index = GetIndexOf(component, this);
+	if (index != -1)
+		RemoveArrayIndex(component, index);
+	lib_linked.line_component = [this];
+
+	// The engine clears the action target of a removed structure before the line breaks. That structure
+	// may have connected several parts of the component, so the remaining lines are grouped again.
+	if (!GetActionTarget(0) || !GetActionTarget(1))
 	{
-		// Store all the objects found in the last iteration which are not this object.
-		for (var link in iterate_objects)
+		var remaining_lines = [];
+		for (var line in component)
 		{
-			if (link != this)
-				PushBack(current_linked_objects, link);
+			if (line && line->IsPowerLine())
+				PushBack(remaining_lines, line);
 		}
-		// Find the new iteration of objects which are connected to the objects in the previous iteration.
-		var previous_iterate_objects = iterate_objects;
-		iterate_objects = [];
-		for (var prev_object in previous_iterate_objects)
+		PowerLine->RefreshLineNetworks(remaining_lines);
+		return remaining_lines;
+	}
+
+	var detached_lines = PowerLine->FindDetachedLines(GetActionTarget(0), GetActionTarget(1), this);
+	if (!detached_lines || GetLength(detached_lines) == 0)
+		return component;
+
+	var is_detached = {};
+	for (var line in detached_lines)
+		is_detached[Format("%d", line->ObjectNumber())] = true;
+	var remaining = 0;
+	for (var line in component)
+	{
+		if (line && !is_detached[Format("%d", line->ObjectNumber())])
+			component[remaining++] = line;
+	}
+	SetLength(component, remaining);
+
+	// The old network is refreshed by the new lines, so only the nodes on the detached side move.
+	var helper = GetPowerSystem()->CreateNetwork(false);
+	for (var line in detached_lines)
+	{
+		line->SetLineComponent(detached_lines, helper);
+	}
+	return component;
+}
+
+
+// Merges the component of this line with the components of the lines at its ends. The largest
+// component keeps its array and helper, the lines of the other components are moved into it.
+// If the helper of this line is still used by its previous component, it is not kept.
+func JoinLineComponents(bool helper_is_shared)
+{
+	var components = [lib_linked.line_component];
+	var helpers = [GetPowerHelper()];
+	if (helper_is_shared)
+		helpers[0] = nil;
+	var is_listed = {};
+	for (var end in [GetActionTarget(0), GetActionTarget(1), pipe_kit])
+	{
+		for (var line in PowerLine->GetAttachedLines(end))
 		{
-			for (var link in found_objects)
+			if (!line || line == this || !line->IsPowerLine())
+				continue;
+			// Each component has its own helper, so the helper identifies the component.
+			var key = Format("%d", (line->GetPowerHelper() ?? line)->ObjectNumber());
+			if (is_listed[key])
+				continue;
+			is_listed[key] = true;
+			PushBack(components, line.lib_linked.line_component);
+			PushBack(helpers, line->GetPowerHelper());
+		}
+	}
+
+	var largest = 0;
+	for (var index = 1; index < GetLength(components); index++)
+	{
+		if (largest == 0 || GetLength(components[index]) > GetLength(components[largest]))
+			largest = index;
+	}
+	var component = components[largest];
+	var helper = helpers[largest] ?? GetPowerSystem()->CreateNetwork(false);
+
+	var moved_lines = [];
+	for (var index = 0; index < GetLength(components); index++)
+	{
+		if (index == largest)
+			continue;
+		for (var line in components[index])
+		{
+			if (line)
 			{
-				// And must not be an already found object or this object.
-				if (GetIndexOf(current_linked_objects, link) != -1 || link == this)
-				{
+				PushBack(component, line);
+				PushBack(moved_lines, line);
+			}
+		}
+	}
+	for (var line in moved_lines)
+	{
+		line->SetLineComponent(component, helper);
+	}
+	// This line may be the only line of the component, then it was not moved.
+	SetLineComponent(component, helper);
+}
+
+
+// Definition call: checks whether the two ends of a removed line are still connected by other lines.
+// Searches from both ends at the same time, one end per step, until the searches meet or one of them
+// runs out of lines. So the search only visits about twice the lines of the smaller side.
+// Returns nil if the ends are still connected, otherwise the lines on the smaller side. Both ends have to exist.
+func FindDetachedLines(object end0, object end1, object removed_line)
+{
+	if (!end0 || !end1 || end0 == end1)
+		return nil;
+	var side_of_end = {};
+	side_of_end[Format("%d", end0->ObjectNumber())] = 1;
+	side_of_end[Format("%d", end1->ObjectNumber())] = 2;
+	var queues = [[end0], [end1]];
+	var heads = [0, 0];
+	var found_lines = [[], []];
+	var is_found_line = {};
+	while (true)
+	{
+		for (var side = 0; side < 2; side++)
+		{
+			if (heads[side] >= GetLength(queues[side]))
+			{
+				return found_lines[side];
+			}
+			var end = queues[side][heads[side]++];
+			for (var line in PowerLine->GetAttachedLines(end))
+			{
+				if (!line || line == removed_line || !line->IsPowerLine())
 					continue;
-				}
-				// Neither may it be an already found object in this loop.
-				if (GetIndexOf(iterate_objects, link) != -1)
-				{
+				var line_key = Format("%d", line->ObjectNumber());
+				if (is_found_line[line_key])
 					continue;
-				}
-				// Last, check whether the new object is really connected to the previous object.
-				if (!prev_object->~IsConnectedTo(link))
+				is_found_line[line_key] = true;
+				PushBack(found_lines[side], line);
+				for (var other in [line->GetActionTarget(0), line->GetActionTarget(1), line.pipe_kit])
 				{
-					continue;
+					if (!other || other == end)
+						continue;
+					var key = Format("%d", other->ObjectNumber());
+					var other_side = side_of_end[key];
+					if (other_side == side + 1)
+						continue;
+					// Reached an end that the other search found already.
+					if (other_side)
+						return nil;
+					side_of_end[key] = side + 1;
+					PushBack(queues[side], other);
 				}
-				PushBack(iterate_objects, link);
 			}
 		}
 	}
+}
 
-	//Log("Updated power lines for %v: %v", this, current_linked_objects);
 
+// Definition call: returns the representative of the set that contains index, halving the path on the way.
+func FindLineSet(array parent, int index)
+{
+	while (parent[index] != index)
+	{
+		parent[index] = parent[parent[index]];
+		index = parent[index];
+	}
+	return index;
+}
 
-	// Update the linked objects of this object.
-	lib_linked.linked_objects = current_linked_objects;
 
-	// Update the linked objects for all other linked objects as well.
-	for (var other in GetLinkedObjects())
+// Definition call: merges the sets of two lines, the smaller set is attached to the larger one.
+func UnionLineSets(array parent, array size, int a, int b)
+{
+	a = FindLineSet(parent, a);
+	b = FindLineSet(parent, b);
+	if (a == b)
+		return;
+	if (size[a] < size[b])
 	{
-		other->CopyLinkedObjects(this, current_linked_objects);
+		var swap = a;
+		a = b;
+		b = swap;
 	}
-	// Since the connected objects have been updated it is necessary to update the power helper as well.
-	// We then just possibly remove the old ones if they exist.
-	var helper = GetPowerSystem()->CreateNetwork(false);
-	//Log("Created network helper %v", helper);
-	SetPowerHelper(helper, true, false);
-	// Now merge all networks into the newly created network.
-	GetPowerSystem()->RefreshAllPowerNetworks();
-	//Log("Network helper after refreshing all networks %v", helper);
-	//ScheduleCall(this, this.Log, 2, 0, "After network update helper is %v", helper);
+	parent[b] = a;
+	size[a] += size[b];
 }
 
 
-// Copy the linked objects from another object (from) and its object list.
-func CopyLinkedObjects(object from, array object_list)
+// Sets the lines that this line is connected to, including this line, and the helper of that component.
+func SetLineComponent(array component, object helper)
 {
-	lib_linked.linked_objects = object_list[:];
-	for (var i = GetLength(lib_linked.linked_objects) - 1; i >= 0; --i)
-		if (lib_linked.linked_objects[i] == this)
-			lib_linked.linked_objects[i] = from;
-	return;
+	lib_linked.line_component = component;
+	var old_helper = GetPowerHelper();
+	if (old_helper == helper)
+		return;
+	if (old_helper)
+		GetPowerSystem()->RefreshPowerNetworkMembers(old_helper);
+	lib_linked.power_helper = helper;
+	GetPowerSystem()->InvalidatePowerNetworkCache();
+	RefreshLineEnds();
 }
 
 
-public func GetLinkedObjects() {return lib_linked.linked_objects; }
+// Sets the component and helper that were saved for this line, without refreshing the ends.
+// The power system checks that the component matches the lines before, see RestorePowerLinks().
+public func RestoreLineComponent(array component, object helper)
+{
+	lib_linked.line_component = component;
+	lib_linked.power_helper = helper;
+}
+
+
+// Marks the objects at both ends of this line for a power network refresh.
+func RefreshLineEnds()
+{
+	for (var index = 0; index < 2; index++)
+	{
+		var target = GetActionTarget(index);
+		if (target)
+		{
+			GetPowerSystem()->RefreshPowerNode(target, "line_change");
+		}
+	}
+}
+
+
+// Returns the other lines in the component of this line.
+public func GetLinkedObjects()
+{
+	var linked_objects = [];
+	for (var line in lib_linked.line_component)
+	{
+		if (line != this)
+			PushBack(linked_objects, line);
+	}
+	return linked_objects;
+}
 
 
 /*-- Power System --*/
@@ -314,12 +663,13 @@ public func SetPowerHelper(object to, bool update_linked_objects, bool report_in
 {
 	var old_network = GetPowerHelper();
 	lib_linked.power_helper = to;
+	GetPowerSystem()->InvalidatePowerNetworkCache();
 	// Update linked objects
 	if (update_linked_objects)
 	{
-		for (var linked_object in GetLinkedObjects())
+		for (var linked_object in lib_linked.line_component)
 		{
-			if (!linked_object)
+			if (!linked_object || linked_object == this)
 				continue;
 			// Assert different power helpers for the same network.
 			if (report_inconsistency && linked_object->GetPowerHelper() != old_network)
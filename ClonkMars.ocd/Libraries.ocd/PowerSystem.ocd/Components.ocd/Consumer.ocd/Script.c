@@ -58,6 +58,12 @@ func SetPowerConsumption(int amount)
 		FatalError(Format("Power consumption must be >= 0, was %d", amount));
 	}
 
+	// Nothing to do for the network if the consumption does not change.
+	if (amount == lib_power_system.consumer.power_need)
+	{
+		return;
+	}
+
 	// Callback to visualization
 	if (HasEnoughPower())
 	{
@@ -66,6 +72,7 @@ func SetPowerConsumption(int amount)
 
 	// Update the value
 	lib_power_system.consumer.power_need = amount;
+	GetPowerSystem()->UpdateNetworkTotalsForPowerLink(this);
 }
 
 
@@ -103,6 +110,7 @@ func SetConsumerPriority(int priority)
 	}
 
 	lib_power_system.consumer.priority = priority;
+	GetPowerSystem()->UpdatePriorityForPowerLink(this);
 }
 
 
@@ -137,6 +145,7 @@ func OnEnoughPower(int amount)
 
 	// Update the status
 	lib_power_system.consumer.has_enough_power = true;
+	GetPowerSystem()->UpdateNetworkTotalsForPowerLink(this);
 
 	// Let the parent class handle things
 	_inherited(amount, ...);
@@ -160,6 +169,7 @@ func OnNotEnoughPower(int amount)
 
 	// Update the status
 	lib_power_system.consumer.has_enough_power = false;
+	GetPowerSystem()->UpdateNetworkTotalsForPowerLink(this);
 
 	// Let the parent class handle things
 	_inherited(amount, ...);
@@ -249,7 +259,7 @@ func Destruction()
  */
 func OnOwnerChanged(int new_owner, int old_owner)
 {
-	GetPowerSystem()->TransferPowerLink(this);
+	GetPowerSystem()->TransferPowerLink(this, "owner_change");
 	return _inherited(new_owner, old_owner, ...);
 }
 
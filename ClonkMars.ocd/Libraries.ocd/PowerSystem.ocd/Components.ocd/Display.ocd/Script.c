@@ -11,6 +11,52 @@
 public func IsPowerDisplay() { return true; }
 
 
+/* -- Network Subscription -- */
+
+
+/**
+ * All power related local variables are stored in a single proplist.
+ * The display uses it only for caching its network.
+ */
+local lib_power_system;
+
+
+/**
+ * Construction callback by the engine: subscribe to the power network,
+ * so that the display is notified about balance changes.
+ */
+func Construction()
+{
+	// Initialize the single proplist for the power system.
+	if (lib_power_system == nil)
+	{
+		lib_power_system = {};
+	}
+	GetPowerSystem()->RegisterPowerDisplay(this);
+	return _inherited(...);
+}
+
+
+/**
+ * Destruction callback by the engine: the display must always be unsubscribed.
+ */
+func Destruction()
+{
+	GetPowerSystem()->UnregisterPowerDisplay(this);
+	return _inherited(...);
+}
+
+
+/**
+ * When ownership has changed, the display may have moved out of or into a new network.
+ */
+func OnOwnerChanged(int new_owner, int old_owner)
+{
+	GetPowerSystem()->TransferPowerLink(this, "owner_change");
+	return _inherited(new_owner, old_owner, ...);
+}
+
+
 /* -- Interaction Menu -- */
 
 
@@ -107,10 +153,59 @@ func GetPowerDisplayMenuEntries(object clonk)
 		Text = Format("$MsgPowerStored$ %s {{Icon_Lightbulb}} ($MsgPowerStoredCapacity$ %s {{Icon_Lightbulb}})", GetStoredPowerString(power_stored), GetStoredPowerString(power_stored_capacity))
 	};
 	PushBack(menu_entries, {symbol = Icon_Lightbulb, extra_data = "storage", custom = entry});
+
+	// Show the recent production and consumption, as recorded by the network.
+	var production_history = power_network->GetPowerHistory("production");
+	var consumption_history = power_network->GetPowerHistory("consumption");
+	if (GetLength(production_history) > 1)
+	{
+		var entry =
+		{
+			Style = GUI_FitChildren,
+			Bottom = "3em",
+			BackgroundColor = {Std = 0, OnHover = 0x50ff0000},
+			Priority = 3,
+			graph = GetPowerTrendGraph(production_history, consumption_history)
+		};
+		PushBack(menu_entries, {symbol = Icon_Lightbulb, extra_data = "trend", custom = entry});
+	}
 	return menu_entries;
 }
 
 
+// Draws a bar for each recorded value: production in green and consumption in red in front of it.
+func GetPowerTrendGraph(array production_history, array consumption_history)
+{
+	var graph = {};
+	var count = GetLength(production_history);
+	var max_value = 1;
+	for (var i = 0; i < count; i++)
+	{
+		max_value = Max(max_value, Max(production_history[i], consumption_history[i]));
+	}
+	for (var i = 0; i < count; i++)
+	{
+		var left = 100 * i / count;
+		var right = 100 * (i + 1) / count;
+		graph[Format("production%d", i)] =
+		{
+			Left = Format("%d%%", left),
+			Right = Format("%d%%", right),
+			Top = Format("%d%%", 100 - 100 * production_history[i] / max_value),
+			BackgroundColor = RGBa(0, 200, 0, 160)
+		};
+		graph[Format("consumption%d", i)] =
+		{
+			Left = Format("%d%%", (left + right) / 2),
+			Right = Format("%d%%", right),
+			Top = Format("%d%%", 100 - 100 * consumption_history[i] / max_value),
+			BackgroundColor = RGBa(200, 0, 0, 160)
+		};
+	}
+	return graph;
+}
+
+
 // Update the hover info display of the interaction menu.
 func OnPowerDisplayHover(id symbol, string extra_data, desc_menu_target, menu_id)
 {
@@ -144,6 +239,11 @@ func OnPowerDisplayHover(id symbol, string extra_data, desc_menu_target, menu_id
 				text = Format("%s $DescPowerUnderproduction$", text, -over_production);
 		
 		}
+		else if (extra_data == "trend")
+		{
+			var seconds = GetLength(power_network->GetPowerHistory("production")) * POWER_SYSTEM_HISTORY_Interval / 36;
+			text = Format("$DescPowerTrend$", seconds);
+		}
 		else if (extra_data == "nopowerneed")
 		{
 			text = "$DescPowerNoNeed$";
@@ -164,6 +264,15 @@ func GetStoredPowerString(int stored_power)
 }
 
 
+// Called when the network recorded its power history.
+func OnPowerHistoryChange(object network)
+{
+	// Update the interaction menus.
+	UpdateInteractionMenus(this.GetPowerDisplayMenuEntries);
+	return;
+}
+
+
 // Called when the power balance of this network changed.
 func OnPowerBalanceChange(object network)
 {
@@ -7,11 +7,12 @@
  */
 public func AddPowerProducer(object producer)
 {
-	if (!IsValueInArray(power_producers, producer))
+	if (!GetProducerLink(producer))
 	{
-		PushBack(power_producers, producer);	
-		SortProducers(); // This is necessary only when adding an object to the list
-		GetPowerSystem()->DebugInfo("POWR - AddPowerProducer(): network = %v, frame = %d, producer = %s, all producers: %v", this, FrameCounter(), LogObject(producer), power_producers);
+		var account = GetPowerAccount(producer, true);
+		BookPowerProducer(producer, account);
+		AddToPriorityBucket(producer_buckets, producer, account.producer, producer->GetProducerPriority());
+		GetPowerSystem()->DebugInfo("POWR - AddPowerProducer(): network = %v, frame = %d, producer = %s, all producers: %v", this, FrameCounter(), LogObject(producer), producer_buckets);
 		SchedulePowerBalanceUpdate(); // Check the power balance of this network, since a change has been made.
 	}
 }
@@ -22,14 +23,16 @@ public func AddPowerProducer(object producer)
  */
 public func RemovePowerProducer(object producer)
 {
-	if (IsValueInArray(power_producers, producer))
+	if (GetProducerLink(producer))
 	{
 		if (producer->IsPowerProductionActive())
 		{
 			producer->OnPowerProductionStop();
 		}
-		RemoveArrayValue(power_producers, producer);	
-		GetPowerSystem()->DebugInfo("POWR - RemovePowerProducer(): network = %v, frame = %d, producer = %s, all producers: %v", this, FrameCounter(), LogObject(producer), power_producers);
+		var account = GetPowerAccount(producer);
+		RemoveFromPriorityBucket(producer_buckets, account.producer, "producer");
+		UnbookPowerProducer(account);
+		GetPowerSystem()->DebugInfo("POWR - RemovePowerProducer(): network = %v, frame = %d, producer = %s, all producers: %v", this, FrameCounter(), LogObject(producer), producer_buckets);
 		SchedulePowerBalanceUpdate(); // Check the power balance of this network, since a change has been made.
 	}
 }
@@ -40,11 +43,13 @@ public func RemovePowerProducer(object producer)
  */
 public func AddPowerConsumer(object consumer)
 {
-	if (!IsValueInArray(power_consumers, consumer))
+	if (!GetConsumerLink(consumer))
 	{
-		PushBack(power_consumers, consumer);
-		SortConsumers(); // This is necessary only when adding an object to the list
-		GetPowerSystem()->DebugInfo("POWR - AddPowerConsumer(): network = %v, frame = %d, consumer = %s, all consumers: %v", this, FrameCounter(), LogObject(consumer), power_consumers);
+		var account = GetPowerAccount(consumer, true);
+		BookPowerConsumer(consumer, account);
+		AddToPriorityBucket(consumer_buckets, consumer, account.consumer, consumer->GetConsumerPriority());
+		consumer_supply_order = nil;
+		GetPowerSystem()->DebugInfo("POWR - AddPowerConsumer(): network = %v, frame = %d, consumer = %s, all consumers: %v", this, FrameCounter(), LogObject(consumer), consumer_buckets);
 		SchedulePowerBalanceUpdate(); // Check the power balance of this network, since a change has been made.
 	}
 }
@@ -55,10 +60,13 @@ public func AddPowerConsumer(object consumer)
  */
 public func RemovePowerConsumer(object consumer)
 {
-	if (IsValueInArray(power_consumers, consumer))
+	if (GetConsumerLink(consumer))
 	{
-		RemoveArrayValue(power_consumers, consumer);	
-		GetPowerSystem()->DebugInfo("POWR - RemovePowerConsumer(): network = %v, frame = %d, consumer = %s, all consumers: %v", this, FrameCounter(), LogObject(consumer), power_consumers);
+		var account = GetPowerAccount(consumer);
+		RemoveFromPriorityBucket(consumer_buckets, account.consumer, "consumer");
+		UnbookPowerConsumer(account);
+		consumer_supply_order = nil;
+		GetPowerSystem()->DebugInfo("POWR - RemovePowerConsumer(): network = %v, frame = %d, consumer = %s, all consumers: %v", this, FrameCounter(), LogObject(consumer), consumer_buckets);
 		SchedulePowerBalanceUpdate(); // Check the power balance of this network, since a change has been made.
 	}
 }
@@ -69,8 +77,11 @@ public func RemovePowerConsumer(object consumer)
  */
 public func AddPowerStorage(object storage)
 {
-	if (!IsValueInArray(power_storages, storage))
+	if (!GetStorageLink(storage))
 	{
+		var account = GetPowerAccount(storage, true);
+		BookPowerStorage(storage, account);
+		account.storage.index = GetLength(power_storages);
 		PushBack(power_storages, storage);
 		GetPowerSystem()->DebugInfo("POWR - AddPowerStorage(): network = %v, frame = %d, storage = %s, all storages: %v", this, FrameCounter(), LogObject(storage), power_storages);
 		SchedulePowerBalanceUpdate(); // Check the power balance of this network, since a change has been made.
@@ -83,9 +94,11 @@ public func AddPowerStorage(object storage)
  */
 public func RemovePowerStorage(object storage)
 {
-	if (IsValueInArray(power_storages, storage))
+	if (GetStorageLink(storage))
 	{
-		RemoveArrayValue(power_storages, storage);	
+		var account = GetPowerAccount(storage);
+		RemoveIndexedNode(power_storages, account.storage.index, "storage");
+		UnbookPowerStorage(account);
 		GetPowerSystem()->DebugInfo("POWR - RemovePowerStorage(): network = %v, frame = %d, storage = %s, all storages: %v", this, FrameCounter(), LogObject(storage), power_storages);
 		SchedulePowerBalanceUpdate(); // Check the power balance of this network, since a change has been made.
 	}
@@ -93,16 +106,45 @@ public func RemovePowerStorage(object storage)
 
 
 /**
- * Returns the total power available in the network: idle + active producers.
+ * Adds a power display to the network. Displays are notified when the
+ * power balance changes, see NotifyOnPowerBalanceChange().
  */
-public func GetPowerAvailable()
+public func AddPowerDisplay(object display)
 {
-	var total = 0;
-	for (var producer in power_producers)
+	if (!GetDisplayLink(display))
+	{
+		var account = GetPowerAccount(display, true);
+		account.display = { index = GetLength(power_displays) };
+		account.roles |= POWER_NODE_Display;
+		PushBack(power_displays, display);
+		GetPowerSystem()->DebugInfo("POWR - AddPowerDisplay(): network = %v, frame = %d, display = %s, all displays: %v", this, FrameCounter(), LogObject(display), power_displays);
+	}
+}
+
+
+/**
+ * Removes a power display from the network.
+ */
+public func RemovePowerDisplay(object display)
+{
+	if (GetDisplayLink(display))
 	{
-		total += producer->GetPowerProduction();
+		var account = GetPowerAccount(display);
+		RemoveIndexedNode(power_displays, account.display.index, "display");
+		account.display = nil;
+		account.roles &= ~POWER_NODE_Display;
+		ReleasePowerAccount(account);
+		GetPowerSystem()->DebugInfo("POWR - RemovePowerDisplay(): network = %v, frame = %d, display = %s, all displays: %v", this, FrameCounter(), LogObject(display), power_displays);
 	}
-	return total;
+}
+
+
+/**
+ * Returns the total power available in the network: idle + active producers.
+ */
+public func GetPowerAvailable()
+{
+	return power_totals.available;
 }
 
 
@@ -118,15 +160,7 @@ public func GetBarePowerAvailable()
  */
 public func GetActivePowerAvailable()
 {
-	var total = 0;
-	for (var producer in power_producers)
-	{
-		if (producer->~IsPowerProductionActive())
-		{
-			total += producer->GetPowerProduction();
-		}
-	}
-	return total;
+	return power_totals.active;
 }
 
 
@@ -135,12 +169,7 @@ public func GetActivePowerAvailable()
  */
 public func GetPowerConsumptionNeed()
 {
-	var total = 0;
-	for (var consumer in power_consumers)
-	{
-		total += consumer->GetPowerConsumption();
-	}
-	return total;
+	return power_totals.demand;
 }
 
 
@@ -149,15 +178,44 @@ public func GetPowerConsumptionNeed()
  */
 public func GetPowerConsumption(bool exclude_storages)
 {
-	var total = 0;
-	for (var consumer in power_consumers)
+	return power_totals.supplied;
+}
+
+
+/**
+ * Returns the lowest amount of power that a single consumer in the network needs,
+ * or nil if there are no consumers.
+ */
+public func GetLowestPowerConsumption()
+{
+	// The lowest demand cannot be updated by deltas if the consumer
+	// with the lowest demand leaves, so it is recalculated on demand.
+	if (power_totals.lowest_demand == nil)
 	{
-		if (consumer->HasEnoughPower())
+		for (var bucket in consumer_buckets)
+		for (var consumer in bucket.nodes)
 		{
-			total += consumer->GetPowerConsumption();
+			if (!consumer)
+			{
+				continue;
+			}
+			var demand = consumer->GetPowerConsumption();
+			if (power_totals.lowest_demand == nil || demand < power_totals.lowest_demand)
+			{
+				power_totals.lowest_demand = demand;
+			}
 		}
 	}
-	return total;
+	return power_totals.lowest_demand;
+}
+
+
+/**
+ * Returns the total amount of power that the storages with remaining capacity can take up.
+ */
+public func GetStoragePowerCapacity()
+{
+	return power_totals.storage_rate;
 }
 
 
@@ -166,12 +224,7 @@ public func GetPowerConsumption(bool exclude_storages)
  */
 public func GetStoredPowerCapacity()
 {
-	var total = 0;
-	for (var storage in power_storages)
-	{
-		// TODO 	total += consumer->GetPowerConsumption();
-	}
-	return total;
+	return power_totals.capacity;
 }
 
 
@@ -180,12 +233,8 @@ public func GetStoredPowerCapacity()
  */
 public func GetStoredPower()
 {
-	var total = 0;
-	for (var storage in power_storages)
-	{
-		// TODO 	total += consumer->GetPowerConsumption();
-	}
-	return total;
+	// The storages update their account whenever the input changes or they are full or empty.
+	return BoundBy(GetPowerStorageCharge(power_totals), 0, power_totals.capacity);
 }
 
 
@@ -207,92 +256,211 @@ func SetNeutral(bool neutral)
 }
 
 
+/**
+ * Sets the hysteresis band of the network: non-steady producers are switched off
+ * only if the power level exceeds the demand and storage capacity by this amount,
+ * and consumers without power are switched on only if this much is left over
+ * after supplying them.
+ *
+ * @par amount the width of the band in power units, 0 by default.
+ */
+public func SetPowerHysteresis(int amount)
+{
+	power_hysteresis = Max(0, amount);
+	SchedulePowerBalanceUpdate();
+}
+
+
+/**
+ * Returns the hysteresis band of the network, see SetPowerHysteresis().
+ */
+public func GetPowerHysteresis()
+{
+	return power_hysteresis;
+}
+
+
+/**
+ * Sets the minimum time that a producer keeps its state after it was switched,
+ * and that a consumer stays off after it ran out of power. Consumers are always
+ * switched off immediately, because the network cannot supply power it does not have.
+ *
+ * @par frames the minimum dwell time in frames, 0 by default.
+ */
+public func SetPowerMinimumDwellTime(int frames)
+{
+	power_min_dwell = Max(0, frames);
+	SchedulePowerBalanceUpdate();
+}
+
+
+/**
+ * Returns the minimum dwell time of the network, see SetPowerMinimumDwellTime().
+ */
+public func GetPowerMinimumDwellTime()
+{
+	return power_min_dwell;
+}
+
+
+/**
+ * Returns how often producers and consumers in this network were switched
+ * on or off by the power balance update.
+ */
+public func GetPowerToggleCount()
+{
+	return power_toggle_count;
+}
+
+
 /* -- Network State -- */
 
 /**
  * Returns whether the network does not control any power nodes.
+ * Displays count as well, because they would lose their subscription otherwise.
  */
 public func IsEmpty()
 {
-	return GetLength(power_producers) == 0
-		&& GetLength(power_consumers) == 0
-		&& GetLength(power_storages) == 0;
+	return CountPriorityBucketNodes(producer_buckets) == 0
+		&& CountPriorityBucketNodes(consumer_buckets) == 0
+		&& GetLength(power_storages) == 0
+		&& GetLength(power_displays) == 0;
 }
 
 
 /**
- * Sort the producers by priority, descending.
+ * Returns all producers in the network, sorted by priority, descending.
  */
-func SortProducers()
+public func GetPowerProducers()
 {
-	SortPowerNodes(power_producers, false);
+	return GetPriorityBucketNodes(producer_buckets);
 }
 
 
 /**
- * Sort the consumers by priority, descending.
+ * Returns all consumers in the network, sorted by priority, descending.
  */
-func SortConsumers()
+public func GetPowerConsumers()
 {
-	SortPowerNodes(power_consumers, true);
+	return GetPriorityBucketNodes(consumer_buckets);
 }
 
 
 /**
- * Sort a list by descending priority.
+ * Moves a node to the bucket for its new priority, after the priority changed.
  *
- * This is done with the help of a proplist with priority information, then filled back into an array.
- * The priority information is used only here, so there is no need to carry a proplist with all information
- * all the time, and iterating over an array is easier that going through the objects in the proplist.
+ * Does nothing if the node is not registered in this network.
  */
-func SortPowerNodes(array power_nodes, bool for_consumers)
+public func UpdatePowerPriority(object node)
 {
-	// Sort only if it makes sense
-	if (GetLength(power_nodes) > 1)
+	var account = GetPowerAccount(node);
+	if (!account)
 	{
-		// First update the priorities and then sort them according to priority, descending order.
-		var array_of_proplists = GetPriorityList(power_nodes, for_consumers);
-		SortArrayByProperty(array_of_proplists, "priority", true);
-		// Sort the thing back into the array
-		SetLength(power_nodes, 0);
-		for (var description in array_of_proplists)
-		{
-			PushBack(power_nodes, description.node);
-		}
+		return;
+	}
+	if (account.producer && account.producer.priority != node->GetProducerPriority())
+	{
+		RemoveFromPriorityBucket(producer_buckets, account.producer, "producer");
+		AddToPriorityBucket(producer_buckets, node, account.producer, node->GetProducerPriority());
+	}
+	if (account.consumer && account.consumer.priority != node->GetConsumerPriority())
+	{
+		RemoveFromPriorityBucket(consumer_buckets, account.consumer, "consumer");
+		AddToPriorityBucket(consumer_buckets, node, account.consumer, node->GetConsumerPriority());
+		consumer_supply_order = nil;
 	}
 }
 
 
+/* -- Priority Buckets -- */
+
 /**
- * Gets the priorities of either a list of consumers or producers,
- * as a list of proplists, so that they can be sorted with
- * array sorting functions.
+ * Producers and consumers are grouped in buckets by priority, and the buckets
+ * are sorted by descending priority. This way adding a node does not need sorting,
+ * and the priority is cached in the account, so that it is requested only
+ * when the node is added or changes its priority.
+ *
+ * The account also knows the position of the node in its bucket, so that it
+ * can be removed in constant time. The order inside a bucket is not kept for that.
  */
-func GetPriorityList(array power_nodes, bool for_consumers)
+func AddToPriorityBucket(array buckets, object node, proplist entry, int priority)
+{
+	var nodes = GetPriorityBucket(buckets, priority, true).nodes;
+	entry.priority = priority;
+	entry.index = GetLength(nodes);
+	PushBack(nodes, node);
+}
+
+
+func RemoveFromPriorityBucket(array buckets, proplist entry, string role)
 {
-	var list = [];
-	for (var node in power_nodes)
+	var bucket = GetPriorityBucket(buckets, entry.priority);
+	if (bucket)
 	{
-		var description;
-		if (for_consumers)
+		RemoveIndexedNode(bucket.nodes, entry.index, role);
+	}
+}
+
+
+func GetPriorityBucket(array buckets, int priority, bool create)
+{
+	// There are only a few different priorities, so a linear search is fast enough.
+	var count = GetLength(buckets);
+	var index = 0;
+	for (; index < count; ++index)
+	{
+		if (buckets[index].priority == priority)
 		{
-			description = { node = node, priority = node->GetConsumerPriority()};
+			return buckets[index];
 		}
-		else
+		if (buckets[index].priority < priority)
 		{
-			description = { node = node, priority = node->GetProducerPriority()};
+			break;
 		}
-		PushBack(list, description);
 	}
-	return list;
+	if (!create)
+	{
+		return nil;
+	}
+	// Insert a new bucket at the position that keeps the order.
+	for (var i = count; i > index; --i)
+	{
+		buckets[i] = buckets[i - 1];
+	}
+	buckets[index] = { priority = priority, nodes = [] };
+	return buckets[index];
+}
+
+
+func GetPriorityBucketNodes(array buckets)
+{
+	var nodes = [];
+	for (var bucket in buckets)
+	{
+		nodes = Concatenate(nodes, bucket.nodes);
+	}
+	return nodes;
+}
+
+
+func CountPriorityBucketNodes(array buckets)
+{
+	var count = 0;
+	for (var bucket in buckets)
+	{
+		count += GetLength(bucket.nodes);
+	}
+	return count;
 }
 
+
 /**
  * Returns whether this network contains a power link.
  */
 public func ContainsPowerLink(object link)
 {
-	return !!GetProducerLink(link) || !!GetConsumerLink(link);
+	var account = GetPowerAccount(link);
+	return account && account.roles != 0;
 }
 
 
@@ -301,7 +469,8 @@ public func ContainsPowerLink(object link)
  */
 public func GetProducerLink(object link)
 {
-	if (IsValueInArray(power_producers, link))
+	var account = GetPowerAccount(link);
+	if (account && (account.roles & POWER_NODE_Producer))
 	{
 		return link;
 	}
@@ -313,7 +482,8 @@ public func GetProducerLink(object link)
  */
 public func GetConsumerLink(object link)
 {
-	if (IsValueInArray(power_consumers, link))
+	var account = GetPowerAccount(link);
+	if (account && (account.roles & POWER_NODE_Consumer))
 	{
 		return link;
 	}
@@ -325,7 +495,21 @@ public func GetConsumerLink(object link)
  */
 public func GetStorageLink(object link)
 {
-	if (IsValueInArray(power_storages, link))
+	var account = GetPowerAccount(link);
+	if (account && (account.roles & POWER_NODE_Storage))
+	{
+		return link;
+	}
+}
+
+
+/**
+ * Returns the display link in this network.
+ */
+public func GetDisplayLink(object link)
+{
+	var account = GetPowerAccount(link);
+	if (account && (account.roles & POWER_NODE_Display))
 	{
 		return link;
 	}
@@ -337,286 +521,1757 @@ public func GetStorageLink(object link)
  */
 func RefreshPowerNetwork()
 {
-	RemoveHoles(power_producers);
-	RemoveHoles(power_consumers);
-	RemoveHoles(power_storages);
 	GetPowerSystem()->DebugInfo("**************************************************************************");
 	GetPowerSystem()->DebugInfo("POWR - Refreshing network %s", LogObject(this));
-	for (var producer in power_producers)
+	if (HasPowerNodeHoles())
 	{
-		// Remove from old network and add to new network.
-		var actual_network = GetPowerSystem()->GetPowerNetwork(producer);
-		if (actual_network && actual_network != this)
-		{
-			this->RemovePowerProducer(producer);
-			actual_network->AddPowerProducer(producer);
-		}
+		RebuildPowerIndex();
 	}
-	for (var consumer in power_consumers)
+	// Group the nodes by the network they actually belong to, so that they can be moved in bulk.
+	var destinations = [];
+	var destination_nodes = {};
+	var remaining_count = 0;
+	for (var key in GetProperties(power_accounts))
 	{
-		// Remove from old network and add to new network.
-		var actual_network = GetPowerSystem()->GetPowerNetwork(consumer);
-		if (actual_network && actual_network != this)
+		var account = power_accounts[key];
+		if (!account || !account.node)
+		{
+			continue;
+		}
+		var actual_network = GetPowerSystem()->GetPowerNetwork(account.node);
+		if (!actual_network || actual_network == this)
+		{
+			remaining_count += 1;
+			continue;
+		}
+		var network_key = Format("%d", actual_network->ObjectNumber());
+		if (!destination_nodes[network_key])
 		{
-			this->RemovePowerConsumer(consumer);
-			actual_network->AddPowerConsumer(consumer);
+			destination_nodes[network_key] = [];
+			PushBack(destinations, actual_network);
 		}
+		PushBack(destination_nodes[network_key], account.node);
 	}
-	for (var storage in power_storages)
+	// All nodes belong to the same other network: the networks were joined.
+	if (remaining_count == 0 && GetLength(destinations) == 1)
+	{
+		MergeNetworkInto(destinations[0]);
+	}
+	else
 	{
-		// Remove from old network and add to new network.
-		var actual_network = GetPowerSystem()->GetPowerNetwork(storage);
-		if (actual_network && actual_network != this)
+		for (var destination in destinations)
 		{
-			this->RemovePowerStorage(storage);
-			actual_network->AddPowerStorage(storage);
+			SplitNodes(destination_nodes[Format("%d", destination->ObjectNumber())], destination);
 		}
 	}
 	GetPowerSystem()->DebugInfo("POWR - Refreshing network %s done - will list all contents now", LogObject(this));
-	GetPowerSystem()->DebugInfo("POWR - Network %s producers: %v", LogObject(this), power_producers);
-	GetPowerSystem()->DebugInfo("POWR - Network %s consumers: %v", LogObject(this), power_consumers);
+	GetPowerSystem()->DebugInfo("POWR - Network %s producers: %v", LogObject(this), producer_buckets);
+	GetPowerSystem()->DebugInfo("POWR - Network %s consumers: %v", LogObject(this), consumer_buckets);
 	GetPowerSystem()->DebugInfo("POWR - Network %s storages: %v", LogObject(this), power_storages);
 	GetPowerSystem()->DebugInfo("**************************************************************************");
 }
 
 
-/*-- Logging --*/
-
-
-func LogState(string tag)
-{
-	GetPowerSystem()->DebugInfo("==========================================================================");
-	GetPowerSystem()->DebugInfo("POWR - State for network %v in frame %d with tag %s", this, FrameCounter(), tag);
-	GetPowerSystem()->DebugInfo("==========================================================================");
-	GetPowerSystem()->DebugInfo("POWR - GetPowerConsumptionNeed() = %d", GetPowerConsumptionNeed());
-	GetPowerSystem()->DebugInfo("POWR - GetBarePowerAvailable() = %d", GetBarePowerAvailable());
-	GetPowerSystem()->DebugInfo("POWR - GetPowerAvailable() = %d", GetPowerAvailable());
-	GetPowerSystem()->DebugInfo("POWR - GetActivePowerAvailable() = %d", GetActivePowerAvailable());
-	GetPowerSystem()->DebugInfo("POWR - GetPowerConsumption() = %d", GetPowerConsumption());
-	GetPowerSystem()->DebugInfo("==========================================================================");
-	return;
-}
-
-
-/* -- Saving -- */
-
+/* -- Bulk Operations -- */
 
 /**
- * Helper object should not be saved.
+ * Moves all nodes of this network into another network, for example when two
+ * networks are joined. The membership index, the priority buckets and the running
+ * totals are moved as a whole, and the other network checks its balance once.
+ *
+ * Unlike removing the nodes one by one, producers are not stopped: the other
+ * network decides about them in its balance update.
  */
-public func SaveScenarioObject()
+public func MergeNetworkInto(object other)
 {
-	if (GetID() == GetPowerSystem())
+	if (!other || other == this)
 	{
-		return false;
+		return;
 	}
-	return inherited(...);
-}
-
-
-/* -- Properties -- */
-
-local power_producers;
-local power_consumers;
-local power_storages;
-local is_neutral;
-
-func Construction()
-{
-	power_producers = [];
-	power_consumers = [];
+	GetPowerSystem()->DebugInfo("POWR - MergeNetworkInto(): network = %v, frame = %d, into network = %v", this, FrameCounter(), other);
+	other->AdoptPowerNodes(producer_buckets, consumer_buckets, power_storages, power_displays, power_accounts, power_totals);
+	producer_buckets = [];
+	consumer_buckets = [];
 	power_storages = [];
-	is_neutral = false;
+	power_displays = [];
+	RebuildPowerIndex();
 }
 
-/* -- Internals -- */
 
 /**
- * Does an update of the power balance in the next frame.
+ * Moves some nodes of this network into another network, for example when a network
+ * is split. If no network is given, a new one is created. Both networks check their
+ * balance once.
  *
- * This is scheduled, so that objects can manipulate
- * the network as they like, without having to worry
- * about infinite recursions and the like.
- */
-public func SchedulePowerBalanceUpdate()
-{
-	if (!GetEffect("FxUpdatePowerBalance", this))
-		CreateEffect(FxUpdatePowerBalance, 1, 1);
-}
-
-local FxUpdatePowerBalance = new Effect {
-	Timer = func ()
-	{
-		Target->DoPowerBalanceUpdate();
-		return FX_Execute_Kill;
-	},
-};
-
-
-/**
- * Checks the power balance after a change to this network: i.e. removal or addition
- * of a consumer or producer.
+ * @return the network that the nodes were moved to.
  */
-func DoPowerBalanceUpdate()
+public func SplitNodes(array nodes, object target)
 {
-	var power_level = 0;	// how much is produced?
-	var power_demand = 0;	// how much is demanded?
-	var power_capacity = 0;	// how much can be saved?
-	var lowest_demand = nil;
-
-	RemoveHoles(power_producers);
-	RemoveHoles(power_consumers);
-	RemoveHoles(power_storages);
-
-	GetPowerSystem()->DebugInfo("==========================================================================");
-	GetPowerSystem()->DebugInfo("POWR - Performing power balance update for network %v in frame %d", this, FrameCounter());
-
-
-	// Add up all power needs to get the total demand
-	for (var consumer in power_consumers)
+	if (!target)
 	{
-		var demand = consumer->GetPowerConsumption();
-		power_demand += demand;
-	
-		if (lowest_demand == nil || demand < lowest_demand)
-		{
-			lowest_demand = demand;
-		}
+		target = GetPowerSystem()->CreateNetwork(false);
 	}
-	var should_produce_power = GetPowerAvailable() >= lowest_demand;
-
-	GetPowerSystem()->DebugInfo("POWR - Consumers demand %d units", power_demand);
-
-	// Add up all storage powers to get total storage power
-	for (var storage in power_storages)
+	if (target == this)
 	{
-		if (storage->GetStorageRemaining() > 0)
-		{
-			power_capacity += storage->GetStoragePower();
-		}
+		return target;
 	}
+	GetPowerSystem()->DebugInfo("POWR - SplitNodes(): network = %v, frame = %d, into network = %v, nodes = %v", this, FrameCounter(), target, nodes);
 
-	// Activate producers if necessary
-	for (var producer in power_producers)
+	var moved_producers = [], moved_consumers = [], moved_storages = [], moved_displays = [];
+	var moved_accounts = {};
+	var moved_totals = NewPowerTotals();
+	for (var node in nodes)
 	{
-		var supply = producer->GetPowerProduction();
-
-		// Not supplied yet? Switch on the producer, if possible
-		if (should_produce_power && (power_level < power_demand))
+		if (!node)
 		{
-			// If production can be started
-			if (!producer->IsPowerProductionActive() && producer->CanPowerProductionStart(Min(power_demand - power_level, supply)))
-			{
-				GetPowerSystem()->DebugInfo("POWR - Switch on producer %s", LogObject(producer));
-				producer->OnPowerProductionStart();
-			}
+			continue;
 		}
-		// All consumers have enough power, so switch off the remaining producers
-		// or the lowest demand cannot be met, so switch all producers off, too
-		else if (power_level >= power_demand + power_capacity)
+		var account = GetPowerAccount(node);
+		if (!account)
 		{
-			if (producer->IsPowerProductionActive() && !producer->~IsSteadyPowerProducer())
-			{
-				GetPowerSystem()->DebugInfo("POWR - Switch off producer %s", LogObject(producer));
-				producer->OnPowerProductionStop();
-			}
+			continue;
 		}
-
-		// Production is on?
-		if (producer->IsPowerProductionActive())
+		if (account.producer)
 		{
-			power_level += supply;
-			GetPowerSystem()->DebugInfo("POWR - %d units created by %s", supply, LogObject(producer));
+			RemoveFromPriorityBucket(producer_buckets, account.producer, "producer");
+			AddToPriorityBucket(moved_producers, node, account.producer, account.producer.priority);
+			MovePowerTotals(moved_totals, account.producer, ["available", "active"]);
 		}
-	}
-
-	GetPowerSystem()->DebugInfo("POWR - Producers supply %d units", power_level);
-
-	// Supply the consumers
-	for (var consumer in power_consumers)
-	{
-		var demand = consumer->GetPowerConsumption();
-		var ignores_power_level = consumer->IsNoPowerNeeded();
-
-		GetPowerSystem()->DebugInfo("POWR - Demand for %s: %d, current power level %d", LogObject(consumer), demand, power_level);
-
-		// Still enough power for this consumer?
-		if ((power_level >= demand) || ignores_power_level)
+		if (account.consumer)
 		{
-			// Reduce available power
-			if (!ignores_power_level)
-			{
-				power_level -= demand;
-			}
-
-			// Non on? Switch on
-			if (!consumer->HasEnoughPower())
+			RemoveFromPriorityBucket(consumer_buckets, account.consumer, "consumer");
+			AddToPriorityBucket(moved_consumers, node, account.consumer, account.consumer.priority);
+			MovePowerTotals(moved_totals, account.consumer, ["demand", "supplied"]);
+			if (account.consumer.demand == power_totals.lowest_demand)
 			{
-				GetPowerSystem()->DebugInfo("POWR - Consumer has enough power: %s", LogObject(consumer));
-				consumer->OnEnoughPower();
+				power_totals.lowest_demand = nil;
 			}
-			GetPowerSystem()->DebugInfo("POWR - %d units consumed by %s", demand, LogObject(consumer));
 		}
-		// Not enough power
-		else
+		if (account.storage)
 		{
-			// Still on? Switch off
-			if (consumer->HasEnoughPower())
-			{
-				GetPowerSystem()->DebugInfo("POWR - Consumer has Insufficient power: %s", LogObject(consumer));
-				consumer->OnNotEnoughPower();
-			}
+			RemoveIndexedNode(power_storages, account.storage.index, "storage");
+			PushBack(moved_storages, node);
+			MovePowerTotals(moved_totals, account.storage, POWER_SYSTEM_STORAGE_TOTALS);
+			MovePowerStorageCharge(power_totals, moved_totals, account.storage);
+		}
+		if (account.display)
+		{
+			RemoveIndexedNode(power_displays, account.display.index, "display");
+			PushBack(moved_displays, node);
 		}
+		moved_accounts[account.key] = account;
+		ForgetPowerAccount(account);
 	}
+	target->AdoptPowerNodes(moved_producers, moved_consumers, moved_storages, moved_displays, moved_accounts, moved_totals);
+	consumer_supply_order = nil;
+	SchedulePowerBalanceUpdate();
+	return target;
+}
 
-	// Put the remaining power into storages
-	// This is done separately from supplying consumers, so that storages do not hinder the consumers
-	// Distribution is equal among all power storages, so that as many storages as possible can
-	// produce at the same time
-	GetPowerSystem()->DebugInfo("POWR - Excess energy is %d units", power_level);
 
-	for (var storage in power_storages)
-	{
-		storage->SetStorageInput(-storage->GetPowerProduction());
-	}
-	while (power_level > 0)
+/**
+ * Takes over nodes from another network. The priority buckets of both networks are
+ * sorted, so they are merged in linear time, and the accounts keep what the nodes
+ * contribute to the totals.
+ */
+func AdoptPowerNodes(array producers, array consumers, array storages, array displays, proplist accounts, proplist totals)
+{
+	for (var key in GetProperties(accounts))
 	{
-		var total_change = 0;
-		for (var storage in power_storages)
+		var account = accounts[key];
+		if (!account)
 		{
-			// Update remaining power level
-			var change = storage->DoStorageInput(1);
-			power_level -= change;
-			total_change += change;
+			continue;
 		}
-		if (total_change == 0)
+		if (power_accounts[key])
 		{
-			break;
+			FatalError(Format("Node %v is in two power networks at the same time.", account.node));
 		}
+		power_accounts[key] = account;
+		power_account_count += 1;
 	}
-	for (var storage in power_storages)
+	producer_buckets = MergePriorityBuckets(producer_buckets, producers, "producer");
+	consumer_buckets = MergePriorityBuckets(consumer_buckets, consumers, "consumer");
+	AppendIndexedNodes(power_storages, storages, "storage");
+	AppendIndexedNodes(power_displays, displays, "display");
+
+	power_totals.available += totals.available;
+	power_totals.active += totals.active;
+	power_totals.demand += totals.demand;
+	power_totals.supplied += totals.supplied;
+	for (var field in POWER_SYSTEM_STORAGE_TOTALS)
 	{
-		GetPowerSystem()->DebugInfo("Store %d power in %s", storage->GetStorageInput(), LogObject(storage));
+		power_totals[field] += totals[field];
+	}
+	MovePowerStorageCharge(totals, power_totals, totals);
+	if (power_totals.lowest_demand != nil && totals.lowest_demand != nil)
+	{
+		power_totals.lowest_demand = Min(power_totals.lowest_demand, totals.lowest_demand);
+	}
+	else
+	{
+		power_totals.lowest_demand = nil;
+	}
+
+	consumer_supply_order = nil;
+	SchedulePowerBalanceUpdate();
+}
+
+
+/**
+ * Merges two lists of priority buckets, both sorted by descending priority.
+ * The nodes of a bucket with a priority that exists in both lists are appended.
+ */
+func MergePriorityBuckets(array buckets, array other_buckets, string role)
+{
+	var merged = [];
+	var index = 0, other_index = 0;
+	var count = GetLength(buckets), other_count = GetLength(other_buckets);
+	while (index < count || other_index < other_count)
+	{
+		if (other_index >= other_count || (index < count && buckets[index].priority > other_buckets[other_index].priority))
+		{
+			PushBack(merged, buckets[index++]);
+		}
+		else if (index >= count || buckets[index].priority < other_buckets[other_index].priority)
+		{
+			var bucket = { priority = other_buckets[other_index].priority, nodes = [] };
+			AppendIndexedNodes(bucket.nodes, other_buckets[other_index++].nodes, role);
+			PushBack(merged, bucket);
+		}
+		else
+		{
+			AppendIndexedNodes(buckets[index].nodes, other_buckets[other_index++].nodes, role);
+			PushBack(merged, buckets[index++]);
+		}
+	}
+	return merged;
+}
+
+
+/**
+ * Appends nodes to a list and updates their position in their accounts.
+ * The accounts must be in this network already.
+ */
+func AppendIndexedNodes(array nodes, array other_nodes, string role)
+{
+	for (var node in other_nodes)
+	{
+		if (node)
+		{
+			GetPowerAccount(node)[role].index = GetLength(nodes);
+		}
+		PushBack(nodes, node);
+	}
+}
+
+
+func NewPowerTotals()
+{
+	return { available = 0, active = 0, demand = 0, supplied = 0, storage_rate = 0, capacity = 0, charge_stored = 0, charge_input = 0, charge_frame = FrameCounter(), lowest_demand = nil };
+}
+
+
+/**
+ * Moves what an entry contributes to the running totals of this network to other totals.
+ */
+func MovePowerTotals(proplist totals, proplist entry, array fields)
+{
+	for (var field in fields)
+	{
+		power_totals[field] -= entry[field];
+		totals[field] += entry[field];
+	}
+}
+
+
+/* -- Running Totals -- */
+
+/**
+ * Updates the running totals of this network after a node changed
+ * its production, consumption or storage state.
+ *
+ * Does nothing if the node is not registered in this network.
+ *
+ * @return bool {@c true} if the totals changed, so that the power
+ *              balance has to be checked again.
+ */
+public func UpdatePowerAccount(object node)
+{
+	var account = GetPowerAccount(node);
+	if (!account)
+	{
+		return false;
+	}
+	var available = power_totals.available;
+	var active = power_totals.active;
+	var demand = power_totals.demand;
+	var supplied = power_totals.supplied;
+	var storage_rate = power_totals.storage_rate;
+	if (account.producer)
+	{
+		BookPowerProducer(node, account);
+	}
+	if (account.consumer)
+	{
+		BookPowerConsumer(node, account);
+	}
+	if (account.storage)
+	{
+		BookPowerStorage(node, account);
+	}
+	return available != power_totals.available
+		|| active != power_totals.active
+		|| demand != power_totals.demand
+		|| supplied != power_totals.supplied
+		|| storage_rate != power_totals.storage_rate;
+}
+
+
+func BookPowerProducer(object producer, proplist account)
+{
+	var entry = account.producer;
+	if (!entry)
+	{
+		entry = { available = 0, active = 0 };
+		account.producer = entry;
+		account.roles |= POWER_NODE_Producer;
+	}
+
+	// Take back the old contribution, then add the current one.
+	power_totals.available -= entry.available;
+	power_totals.active -= entry.active;
+	entry.available = producer->GetPowerProduction();
+	entry.active = 0;
+	if (producer->IsPowerProductionActive())
+	{
+		entry.active = entry.available;
+	}
+	power_totals.available += entry.available;
+	power_totals.active += entry.active;
+}
+
+
+func UnbookPowerProducer(proplist account)
+{
+	power_totals.available -= account.producer.available;
+	power_totals.active -= account.producer.active;
+	account.producer = nil;
+	account.roles &= ~POWER_NODE_Producer;
+	ReleasePowerAccount(account);
+}
+
+
+func BookPowerConsumer(object consumer, proplist account)
+{
+	var entry = account.consumer;
+	var old_demand = nil;
+	if (entry)
+	{
+		old_demand = entry.demand;
+		power_totals.demand -= entry.demand;
+		power_totals.supplied -= entry.supplied;
+	}
+	else
+	{
+		entry = {};
+		account.consumer = entry;
+		account.roles |= POWER_NODE_Consumer;
+	}
+
+	entry.demand = consumer->GetPowerConsumption();
+	if (entry.demand != old_demand)
+	{
+		// The prefix sums of the demands are outdated.
+		consumer_supply_order = nil;
+	}
+	entry.supplied = 0;
+	if (consumer->HasEnoughPower())
+	{
+		entry.supplied = entry.demand;
+	}
+	power_totals.demand += entry.demand;
+	power_totals.supplied += entry.supplied;
+
+	// Keep track of the lowest demand: it is unknown again
+	// if the consumer with the lowest demand increases its demand.
+	if (power_totals.lowest_demand != nil)
+	{
+		if (entry.demand < power_totals.lowest_demand)
+		{
+			power_totals.lowest_demand = entry.demand;
+		}
+		else if (old_demand == power_totals.lowest_demand && entry.demand > old_demand)
+		{
+			power_totals.lowest_demand = nil;
+		}
+	}
+}
+
+
+func UnbookPowerConsumer(proplist account)
+{
+	power_totals.demand -= account.consumer.demand;
+	power_totals.supplied -= account.consumer.supplied;
+	if (account.consumer.demand == power_totals.lowest_demand)
+	{
+		power_totals.lowest_demand = nil;
+	}
+	account.consumer = nil;
+	account.roles &= ~POWER_NODE_Consumer;
+	ReleasePowerAccount(account);
+}
+
+
+func BookPowerStorage(object storage, proplist account)
+{
+	var entry = account.storage;
+	if (!entry)
+	{
+		entry = { storage_rate = 0, capacity = 0, charge_stored = 0, charge_input = 0, charge_frame = FrameCounter() };
+		account.storage = entry;
+		account.roles |= POWER_NODE_Storage;
+	}
+
+	power_totals.storage_rate -= entry.storage_rate;
+	entry.storage_rate = 0;
+	if (storage->GetStorageRemaining() > 0)
+	{
+		entry.storage_rate = storage->GetStoragePower();
+	}
+	power_totals.storage_rate += entry.storage_rate;
+	BookPowerStorageCharge(storage, entry);
+}
+
+
+/**
+ * Updates what a storage contributes to the stored power and capacity of this network.
+ * This does not change the power balance, so the storage can do it whenever its charge changes.
+ */
+public func UpdatePowerStorageCharge(object storage)
+{
+	var account = GetPowerAccount(storage);
+	if (account && account.storage)
+	{
+		BookPowerStorageCharge(storage, account.storage);
+	}
+}
+
+
+func BookPowerStorageCharge(object storage, proplist entry)
+{
+	power_totals.capacity -= entry.capacity;
+	// Taking back the charge as it was extrapolated also takes back the part beyond full or empty,
+	// if the storage was booked again only after it was full or empty.
+	var booked_charge = GetPowerStorageCharge(entry);
+	AnchorPowerStorageCharge(power_totals);
+	power_totals.charge_stored -= booked_charge;
+	power_totals.charge_input -= entry.charge_input;
+
+	// The stored power changes linearly with the input until the storage is full or empty,
+	// where the storage books its charge again. The input of a full or empty storage is not booked.
+	var input = storage->GetStorageInput();
+	if ((input > 0 && storage->GetStorageRemaining() == 0) || (input < 0 && storage->GetStoredPower() == 0))
+	{
+		input = 0;
+	}
+	entry.capacity = storage->GetStorageCapacity();
+	entry.charge_stored = storage->GetStoredPower();
+	entry.charge_input = input;
+	entry.charge_frame = FrameCounter();
+
+	power_totals.capacity += entry.capacity;
+	power_totals.charge_stored += entry.charge_stored;
+	power_totals.charge_input += entry.charge_input;
+}
+
+
+func UnbookPowerStorage(proplist account)
+{
+	for (var field in POWER_SYSTEM_STORAGE_TOTALS)
+	{
+		power_totals[field] -= account.storage[field];
+	}
+	MovePowerStorageCharge(power_totals, NewPowerTotals(), account.storage);
+	account.storage = nil;
+	account.roles &= ~POWER_NODE_Storage;
+	ReleasePowerAccount(account);
+}
+
+
+/**
+ * Returns the stored power of a storage entry or of the running totals, without
+ * the bounds of the storages. The charge is anchored at the frame where it was
+ * booked, so that the numbers stay small however long the round runs.
+ */
+func GetPowerStorageCharge(proplist charge)
+{
+	return charge.charge_stored + charge.charge_input * (FrameCounter() - charge.charge_frame);
+}
+
+
+/**
+ * Moves the anchor of the running totals to the current frame.
+ */
+func AnchorPowerStorageCharge(proplist totals)
+{
+	totals.charge_stored = GetPowerStorageCharge(totals);
+	totals.charge_frame = FrameCounter();
+}
+
+
+/**
+ * Moves the charge of a storage entry, or of other totals, from some totals to other totals.
+ */
+func MovePowerStorageCharge(proplist from, proplist to, proplist charge)
+{
+	var stored = GetPowerStorageCharge(charge);
+	var input = charge.charge_input;
+	AnchorPowerStorageCharge(from);
+	AnchorPowerStorageCharge(to);
+	from.charge_stored -= stored;
+	from.charge_input -= input;
+	to.charge_stored += stored;
+	to.charge_input += input;
+}
+
+
+/* -- Membership Index -- */
+
+/**
+ * Gets the account of a node: it stores the roles of the node in this network
+ * (see POWER_NODE_*), its position in the node lists and what it contributes
+ * to the running totals. The accounts are indexed by object number, so that
+ * membership tests and removals take constant time.
+ */
+func GetPowerAccount(object node, bool create)
+{
+	var key = Format("%d", node->ObjectNumber());
+	var account = power_accounts[key];
+	if (!account && create)
+	{
+		account = { node = node, key = key, roles = 0 };
+		power_accounts[key] = account;
+		power_account_count += 1;
+	}
+	return account;
+}
+
+
+/**
+ * Removes the account from the index, once the node has no role in this network anymore.
+ */
+func ReleasePowerAccount(proplist account)
+{
+	if (account.roles != 0)
+	{
+		return;
+	}
+	ForgetPowerAccount(account);
+}
+
+
+/**
+ * Removes the account from the index, regardless of the roles of the node.
+ */
+func ForgetPowerAccount(proplist account)
+{
+	// Properties cannot be deleted from a proplist, so the index is copied
+	// once there are more released than active accounts.
+	power_accounts[account.key] = nil;
+	power_account_count -= 1;
+	power_accounts_released += 1;
+	if (power_accounts_released > Max(16, power_account_count))
+	{
+		var index = {};
+		for (var key in GetProperties(power_accounts))
+		{
+			if (power_accounts[key])
+			{
+				index[key] = power_accounts[key];
+			}
+		}
+		power_accounts = index;
+		power_accounts_released = 0;
+	}
+}
+
+
+/**
+ * Removes a node from a list in constant time: the last node in the list takes its place.
+ */
+func RemoveIndexedNode(array nodes, int index, string role)
+{
+	var last = GetLength(nodes) - 1;
+	if (index < last)
+	{
+		var moved = nodes[last];
+		nodes[index] = moved;
+		if (moved)
+		{
+			GetPowerAccount(moved)[role].index = index;
+		}
+	}
+	SetLength(nodes, last);
+}
+
+
+/**
+ * Nodes that were removed without unregistering leave holes in the lists.
+ */
+func HasPowerNodeHoles()
+{
+	for (var buckets in [producer_buckets, consumer_buckets])
+	for (var bucket in buckets)
+	{
+		if (GetIndexOf(bucket.nodes, nil) != -1)
+		{
+			return true;
+		}
+	}
+	return GetIndexOf(power_storages, nil) != -1
+		|| GetIndexOf(power_displays, nil) != -1;
+}
+
+
+/**
+ * Rebuilds the membership index, priority buckets and running totals from scratch.
+ * This is necessary only if nodes were removed without unregistering, because
+ * their contribution to the totals is lost.
+ */
+func RebuildPowerIndex()
+{
+	var producers = GetPowerProducers();
+	var consumers = GetPowerConsumers();
+	var storages = power_storages ?? [];
+	var displays = power_displays ?? [];
+	power_accounts = {};
+	power_account_count = 0;
+	power_accounts_released = 0;
+	power_totals = NewPowerTotals();
+	consumer_supply_order = nil;
+	producer_buckets = [];
+	consumer_buckets = [];
+	power_storages = [];
+	power_displays = [];
+	for (var producer in producers)
+	{
+		if (producer)
+		{
+			var account = GetPowerAccount(producer, true);
+			BookPowerProducer(producer, account);
+			AddToPriorityBucket(producer_buckets, producer, account.producer, producer->GetProducerPriority());
+		}
+	}
+	for (var consumer in consumers)
+	{
+		if (consumer)
+		{
+			var account = GetPowerAccount(consumer, true);
+			BookPowerConsumer(consumer, account);
+			AddToPriorityBucket(consumer_buckets, consumer, account.consumer, consumer->GetConsumerPriority());
+		}
+	}
+	for (var storage in storages)
+	{
+		if (storage)
+		{
+			var account = GetPowerAccount(storage, true);
+			BookPowerStorage(storage, account);
+			account.storage.index = GetLength(power_storages);
+			PushBack(power_storages, storage);
+		}
+	}
+	for (var display in displays)
+	{
+		if (display)
+		{
+			var account = GetPowerAccount(display, true);
+			account.display = { index = GetLength(power_displays) };
+			account.roles |= POWER_NODE_Display;
+			PushBack(power_displays, display);
+		}
+	}
+}
+
+
+/* -- History -- */
+
+/**
+ * Returns the recorded values of the network, oldest first. The network
+ * records one value every POWER_SYSTEM_HISTORY_Interval frames and keeps
+ * the last POWER_SYSTEM_HISTORY_Length values.
+ *
+ * @par field one of "production", "consumption", "stored" or "capacity".
+ */
+public func GetPowerHistory(string field)
+{
+	var history = power_history[field];
+	if (!history)
+	{
+		return [];
+	}
+	var values = CreateArray(power_history_count);
+	var start = power_history_index - power_history_count + POWER_SYSTEM_HISTORY_Length;
+	for (var i = 0; i < power_history_count; i++)
+	{
+		values[i] = history[(start + i) % POWER_SYSTEM_HISTORY_Length];
+	}
+	return values;
+}
+
+
+/**
+ * Returns the frame in which the latest values of the history were recorded.
+ */
+public func GetPowerHistoryFrame()
+{
+	return power_history_frame;
+}
+
+
+/**
+ * Records the current totals in the history, overwriting the oldest values.
+ */
+func RecordPowerHistory()
+{
+	power_history_frame = FrameCounter();
+	power_history.production[power_history_index] = GetActivePowerAvailable();
+	power_history.consumption[power_history_index] = GetPowerConsumption();
+	power_history.stored[power_history_index] = GetStoredPower();
+	power_history.capacity[power_history_index] = GetStoredPowerCapacity();
+	power_history_index = (power_history_index + 1) % POWER_SYSTEM_HISTORY_Length;
+	power_history_count = Min(power_history_count + 1, POWER_SYSTEM_HISTORY_Length);
+
+	for (var display_obj in power_displays)
+	{
+		if (display_obj)
+		{
+			display_obj->~OnPowerHistoryChange(this);
+		}
+	}
+}
+
+
+local FxPowerHistory = new Effect {
+	Timer = func ()
+	{
+		Target->RecordPowerHistory();
+		return FX_OK;
+	},
+};
+
+
+/*-- Logging --*/
+
+
+func LogState(string tag)
+{
+	GetPowerSystem()->DebugInfo("==========================================================================");
+	GetPowerSystem()->DebugInfo("POWR - State for network %v in frame %d with tag %s", this, FrameCounter(), tag);
+	GetPowerSystem()->DebugInfo("==========================================================================");
+	GetPowerSystem()->DebugInfo("POWR - GetPowerConsumptionNeed() = %d", GetPowerConsumptionNeed());
+	GetPowerSystem()->DebugInfo("POWR - GetBarePowerAvailable() = %d", GetBarePowerAvailable());
+	GetPowerSystem()->DebugInfo("POWR - GetPowerAvailable() = %d", GetPowerAvailable());
+	GetPowerSystem()->DebugInfo("POWR - GetActivePowerAvailable() = %d", GetActivePowerAvailable());
+	GetPowerSystem()->DebugInfo("POWR - GetPowerConsumption() = %d", GetPowerConsumption());
+	GetPowerSystem()->DebugInfo("==========================================================================");
+	return;
+}
+
+
+/* -- Saving -- */
+
+
+/**
+ * Helper object should not be saved, networks are saved with their topology,
+ * so that loading does not have to find the networks again.
+ */
+public func SaveScenarioObject(props)
+{
+	if (GetID() == GetPowerSystem())
+	{
+		return false;
+	}
+	// Empty networks are created again when they are needed.
+	if (IsEmpty() || !inherited(props, ...))
+	{
+		return false;
+	}
+	SavePowerTopology(props);
+	return true;
+}
+
+
+/**
+ * Saves the state of the network as plain calls with one object each: the
+ * settings, the links that form it, the nodes in their sorted order and the
+ * charge of the storages.
+ */
+public func SavePowerTopology(proplist props)
+{
+	props->AddCall("PowerSettings", this, "SetSavedPowerSettings", is_neutral, power_hysteresis, power_min_dwell);
+
+	var links = GetPowerSystem()->GetPowerLinksOfNetwork(this);
+	for (var index = 0; index < GetLength(links); index++)
+	{
+		props->AddCall(Format("PowerLink%d", index), this, "AddSavedPowerLink", links[index], index);
+	}
+
+	// The position keeps the order of the nodes, independent of the order of the calls.
+	var position = 0;
+	for (var producer in GetPriorityBucketNodes(producer_buckets))
+	{
+		if (producer)
+		{
+			props->AddCall(Format("PowerNode%d", position), this, "AddSavedPowerNode", producer, POWER_NODE_Producer, position++);
+		}
+	}
+	for (var consumer in GetPriorityBucketNodes(consumer_buckets))
+	{
+		if (consumer)
+		{
+			props->AddCall(Format("PowerNode%d", position), this, "AddSavedPowerNode", consumer, POWER_NODE_Consumer, position++);
+		}
+	}
+	for (var storage in power_storages)
+	{
+		if (storage)
+		{
+			props->AddCall(Format("PowerNode%d", position), this, "AddSavedPowerNode", storage, POWER_NODE_Storage, position++, storage->GetStoredPower(), storage->GetStorageInput());
+		}
+	}
+	for (var display in power_displays)
+	{
+		if (display)
+		{
+			props->AddCall(Format("PowerNode%d", position), this, "AddSavedPowerNode", display, POWER_NODE_Display, position++);
+		}
+	}
+}
+
+
+/**
+ * Called from the scenario save: sets the saved settings of the network.
+ * The network is restored by the power system, once all objects are loaded.
+ * See Library_PowerSystem::RestorePowerNetwork().
+ */
+public func SetSavedPowerSettings(bool neutral, int hysteresis, int dwell)
+{
+	var topology = GetSavedPowerTopology();
+	topology.neutral = neutral;
+	topology.hysteresis = hysteresis;
+	topology.dwell = dwell;
+}
+
+
+/**
+ * Called from the scenario save: adds a link that formed the network.
+ */
+public func AddSavedPowerLink(object link, int index)
+{
+	var topology = GetSavedPowerTopology();
+	topology.links[index] = link;
+}
+
+
+/**
+ * Called from the scenario save: adds a node at its position in the sorted
+ * order of the network. Storages also get their charge.
+ */
+public func AddSavedPowerNode(object node, int role, int position, int stored_power, int storage_input)
+{
+	var topology = GetSavedPowerTopology();
+	topology.nodes[position] = [node, role, stored_power, storage_input];
+}
+
+
+// Returns the topology that is being loaded, and queues the network for the restore on first use.
+func GetSavedPowerTopology()
+{
+	if (!saved_topology)
+	{
+		saved_topology = {
+			neutral = false,
+			hysteresis = 0,
+			dwell = 0,
+			links = [],
+			nodes = [],
+		};
+		GetPowerSystem()->RestorePowerNetwork(this);
+	}
+	return saved_topology;
+}
+
+
+/**
+ * Restores the saved topology, if the links still form this network.
+ * Nodes that belong to another network now are left to the refresh.
+ *
+ * @return {@c true} if the links were consistent with the saved topology.
+ */
+public func RestorePowerTopology()
+{
+	var topology = saved_topology;
+	saved_topology = nil;
+	if (!topology)
+	{
+		return false;
+	}
+	// The settings are assigned directly, the restore schedules one balance update in the end.
+	power_hysteresis = Max(0, topology.hysteresis);
+	power_min_dwell = Max(0, topology.dwell);
+	var links = topology.links[:];
+	RemoveHoles(links);
+	if (!topology.neutral && !GetPowerSystem()->RestorePowerLinks(this, links))
+	{
+		GetPowerSystem()->DebugInfo("POWR - Saved topology of network %v does not match the power links", this);
+		SchedulePowerBalanceUpdate();
+		return false;
+	}
+
+	// Adding the nodes in the saved order restores the order within each priority.
+	for (var saved_node in topology.nodes)
+	{
+		if (!saved_node)
+		{
+			continue;
+		}
+		var node = saved_node[0];
+		var role = saved_node[1];
+		if (RestorePowerNode(node, role) && role == POWER_NODE_Storage)
+		{
+			node->SetStoredPower(saved_node[2]);
+			node->SetStorageInput(saved_node[3]);
+		}
+	}
+	SchedulePowerBalanceUpdate();
+	return true;
+}
+
+
+/**
+ * Moves a node from the network that it registered in while loading to this network.
+ *
+ * @return {@c true} if the node is in this network now.
+ */
+func RestorePowerNode(object node, int role)
+{
+	if (!node)
+	{
+		return false;
+	}
+	// Only registered nodes are moved, the others register when they need to.
+	var old_network = GetPowerSystem()->GetRegisteredPowerNetwork(node);
+	if (!old_network || GetPowerSystem()->GetPowerNetwork(node) != this)
+	{
+		return false;
+	}
+	if (old_network == this)
+	{
+		return true;
+	}
+	if (role == POWER_NODE_Producer && old_network->GetProducerLink(node))
+	{
+		old_network->RemovePowerProducer(node);
+		AddPowerProducer(node);
+	}
+	else if (role == POWER_NODE_Consumer && old_network->GetConsumerLink(node))
+	{
+		old_network->RemovePowerConsumer(node);
+		AddPowerConsumer(node);
+	}
+	else if (role == POWER_NODE_Storage && old_network->GetStorageLink(node))
+	{
+		old_network->RemovePowerStorage(node);
+		AddPowerStorage(node);
+	}
+	else if (role == POWER_NODE_Display && old_network->GetDisplayLink(node))
+	{
+		old_network->RemovePowerDisplay(node);
+		AddPowerDisplay(node);
+	}
+	else
+	{
+		return false;
+	}
+	// The network that the node registered in may be empty now.
+	GetPowerSystem()->RefreshPowerNetworkMembers(old_network);
+	return true;
+}
+
+
+/* -- Properties -- */
+
+local producer_buckets;	// producers grouped by priority, see AddToPriorityBucket
+local consumer_buckets;	// consumers grouped by priority, see AddToPriorityBucket
+local power_storages;
+local power_displays;			// displays that are notified about balance changes
+local power_accounts;			// membership index, see GetPowerAccount
+local power_account_count;
+local power_accounts_released;
+local power_totals;				// running totals, so that the getters do not have to iterate the nodes
+local is_neutral;
+local is_balance_update_scheduled;
+local is_balance_update_running;
+local is_balance_queued;			// waits for the scheduler of the power system
+local balance_queued_frame;
+local pending_power_callbacks;		// callbacks of the last balance update, see QueuePowerCallback
+local pending_power_callback_index;
+local power_hysteresis;			// see SetPowerHysteresis
+local power_min_dwell;			// see SetPowerMinimumDwellTime
+local power_toggle_count;		// see GetPowerToggleCount
+local power_stats;				// counters, see Library_PowerSystem::GetPowerStatistics
+local balance_nodes_visited;
+local balance_callbacks_done;		// producers switched by the current balance update
+local power_history;			// ring buffers of the totals, see GetPowerHistory
+local power_history_index;
+local power_history_count;
+local power_history_frame;
+local consumer_supply_order;	// consumers with demand in priority order, see SupplyConsumersByCut
+local consumer_demand_prefix;
+local consumer_demand_suffix_min;
+local consumer_supply_cut;
+local consumer_supply_tail;
+local consumers_without_demand;
+local saved_topology;				// see GetSavedPowerTopology
+
+func Construction()
+{
+	producer_buckets = [];
+	consumer_buckets = [];
+	power_storages = [];
+	power_displays = [];
+	is_neutral = false;
+	power_hysteresis = 0;
+	power_min_dwell = 0;
+	power_toggle_count = 0;
+	power_history = {
+		production = CreateArray(POWER_SYSTEM_HISTORY_Length),
+		consumption = CreateArray(POWER_SYSTEM_HISTORY_Length),
+		stored = CreateArray(POWER_SYSTEM_HISTORY_Length),
+		capacity = CreateArray(POWER_SYSTEM_HISTORY_Length),
+	};
+	power_history_index = 0;
+	power_history_count = 0;
+	power_stats = GetPowerSystem()->NewPowerStatistics();
+	CreateEffect(FxPowerHistory, 1, POWER_SYSTEM_HISTORY_Interval);
+	pending_power_callbacks = [];
+	pending_power_callback_index = 0;
+	RebuildPowerIndex();
+}
+
+/* -- Internals -- */
+
+/**
+ * Does an update of the power balance in the next frame.
+ *
+ * This is scheduled, so that objects can manipulate
+ * the network as they like, without having to worry
+ * about infinite recursions and the like.
+ *
+ * The update is run by the scheduler of the power system,
+ * see Library_PowerSystem::QueuePowerBalanceUpdate().
+ */
+public func SchedulePowerBalanceUpdate()
+{
+	// Changes caused by the update itself do not need another update.
+	if (is_balance_update_running)
+	{
+		return;
+	}
+	// All changes until the update runs are handled by a single update.
+	is_balance_update_scheduled = true;
+	if (!is_balance_queued)
+	{
+		is_balance_queued = true;
+		balance_queued_frame = FrameCounter();
+		GetPowerSystem()->QueuePowerBalanceUpdate(this);
+	}
+}
+
+
+/**
+ * Runs the scheduled power balance update and the callbacks that it causes,
+ * as far as the budget allows. The producers are switched by the update itself,
+ * the callbacks to consumers and displays that do not fit into the budget are
+ * done the next time. A new update discards the callbacks that are left,
+ * because it decides about the same nodes again.
+ *
+ * @par budget the work that may be done, the update itself counts as one.
+ *
+ * @return the work that was done: the callbacks, including the producers switched by the update, plus one for the update.
+ */
+public func RunPowerBalanceUpdate(int budget)
+{
+	var work = 0;
+	is_balance_update_running = true;
+	if (is_balance_update_scheduled)
+	{
+		is_balance_update_scheduled = false;
+		DiscardPowerCallbacks();
+		DoPowerBalanceUpdate();
+		work += 1 + balance_callbacks_done;
+	}
+	work += DoPowerCallbacks(Max(0, budget - work));
+	is_balance_update_running = false;
+	if (!is_balance_update_scheduled && !GetPendingPowerCallbackCount())
+	{
+		is_balance_queued = false;
+	}
+	return work;
+}
+
+
+/**
+ * Returns whether this network waits for the scheduler.
+ */
+public func IsPowerBalanceQueued()
+{
+	return is_balance_queued;
+}
+
+
+/**
+ * Returns the frame in which this network started to wait for the scheduler.
+ */
+public func GetPowerBalanceQueuedFrame()
+{
+	return balance_queued_frame;
+}
+
+
+/**
+ * Returns the number of callbacks of the last power balance update that are not done yet.
+ */
+public func GetPendingPowerCallbackCount()
+{
+	return GetLength(pending_power_callbacks) - pending_power_callback_index;
+}
+
+
+/**
+ * Remembers a callback to a node, which is done by DoPowerCallbacks().
+ *
+ * @par node the producer, consumer or display.
+ * @par role the role of the node that the callback is for, see POWER_NODE_Producer.
+ * @par active whether the producer should start or the consumer is supplied.
+ */
+func QueuePowerCallback(object node, int role, bool active)
+{
+	PushBack(pending_power_callbacks, {node = node, role = role, active = active});
+}
+
+
+/**
+ * Does the remembered callbacks in order, at most as many as the budget allows.
+ * The displays are notified after all other callbacks.
+ *
+ * @return the number of callbacks that were done.
+ */
+func DoPowerCallbacks(int budget)
+{
+	var done = 0;
+	while (pending_power_callback_index < GetLength(pending_power_callbacks) && done < budget)
+	{
+		var callback = pending_power_callbacks[pending_power_callback_index];
+		pending_power_callback_index += 1;
+		if (DoPowerCallback(callback))
+		{
+			done += 1;
+		}
+	}
+	if (pending_power_callback_index >= GetLength(pending_power_callbacks))
+	{
+		pending_power_callbacks = [];
+		pending_power_callback_index = 0;
+	}
+	return done;
+}
+
+
+/**
+ * Does a single remembered callback, unless the node does not need it anymore.
+ * The node books its new state in the running totals itself, see
+ * UpdateNetworkTotalsForPowerLink().
+ *
+ * @return {@c true} if the callback was done.
+ */
+func DoPowerCallback(proplist callback)
+{
+	var node = callback.node;
+	if (!node)
+	{
+		return false;
+	}
+	if (callback.role == POWER_NODE_Producer)
+	{
+		if (node->IsPowerProductionActive() == callback.active)
+		{
+			return false;
+		}
+		if (callback.active)
+		{
+			GetPowerSystem()->DebugInfo("POWR - Switch on producer %s", LogObject(node));
+			node->OnPowerProductionStart();
+		}
+		else
+		{
+			GetPowerSystem()->DebugInfo("POWR - Switch off producer %s", LogObject(node));
+			node->OnPowerProductionStop();
+		}
+		RecordPowerToggle(GetPowerAccount(node).producer);
+		GetPowerSystem()->CountPowerStatistic(this, "producer_flips", 1);
+	}
+	else if (callback.role == POWER_NODE_Consumer)
+	{
+		if (node->HasEnoughPower() == callback.active)
+		{
+			return false;
+		}
+		if (callback.active)
+		{
+			GetPowerSystem()->DebugInfo("POWR - Consumer has enough power: %s", LogObject(node));
+			node->OnEnoughPower();
+		}
+		else
+		{
+			GetPowerSystem()->DebugInfo("POWR - Consumer has Insufficient power: %s", LogObject(node));
+			node->OnNotEnoughPower();
+		}
+		RecordPowerToggle(GetPowerAccount(node).consumer);
+		GetPowerSystem()->CountPowerStatistic(this, "consumer_flips", 1);
+	}
+	else if (callback.role == POWER_NODE_Display)
+	{
+		node->~OnPowerBalanceChange(this);
+		GetPowerSystem()->CountPowerStatistic(this, "display_callbacks", 1);
+	}
+	return true;
+}
+
+
+/**
+ * Drops the callbacks that were not done yet.
+ */
+func DiscardPowerCallbacks()
+{
+	// The supply cut assumes that the consumers were switched, so it has to start over.
+	if (GetPendingPowerCallbackCount())
+	{
+		consumer_supply_order = nil;
+	}
+	pending_power_callbacks = [];
+	pending_power_callback_index = 0;
+}
+
+
+/**
+ * Supplies the consumers in priority order, with the same result as walking them
+ * and supplying each consumer whose demand fits in the remaining power.
+ *
+ * The consumers that fit one after another are a prefix of the order, so the cut
+ * is found by a binary search over the prefix sums of their demands. After the cut
+ * the walk goes on only while the remaining power covers the smallest demand that
+ * is left. Only the consumers between the old and the new cut, and the ones that
+ * were supplied after either cut, can change their supply.
+ *
+ * @return the power that is left after supplying the consumers.
+ */
+func SupplyConsumersByCut(int power_level)
+{
+	var full_update = consumer_supply_order == nil;
+	if (full_update)
+	{
+		BuildConsumerSupplyOrder();
+	}
+	var order = consumer_supply_order;
+	var prefix = consumer_demand_prefix;
+	var suffix_min = consumer_demand_suffix_min;
+	var count = GetLength(order);
+
+	// The largest cut for which the demand before it can be supplied.
+	var low = 0, high = count;
+	while (low < high)
+	{
+		var middle = (low + high + 1) / 2;
+		if (prefix[middle] <= power_level)
+		{
+			low = middle;
+		}
+		else
+		{
+			high = middle - 1;
+		}
+	}
+	var cut = low;
+	power_level -= prefix[cut];
+
+	// The consumer at the cut does not fit, but smaller ones after it might.
+	var tail = [];
+	var is_tail = {};
+	for (var i = cut + 1; i < count && power_level >= suffix_min[i]; i++)
+	{
+		var demand = prefix[i + 1] - prefix[i];
+		balance_nodes_visited += 1;
+		if (demand <= power_level)
+		{
+			power_level -= demand;
+			PushBack(tail, i);
+			is_tail[Format("%d", i)] = true;
+		}
+	}
+
+	GetPowerSystem()->DebugInfo("POWR - Supplying %d of %d consumers in order, and %d after that", cut, count, GetLength(tail));
+
+	// Find the consumers that may have changed.
+	var candidates;
+	if (full_update)
+	{
+		candidates = [];
+		for (var i = 0; i < count; i++)
+		{
+			PushBack(candidates, i);
+		}
+		// Consumers without demand are always supplied.
+		for (var consumer in consumers_without_demand)
+		{
+			if (!QueueConsumerSupply(consumer, true))
+			{
+				consumer_supply_order = nil;
+			}
+		}
+	}
+	else
+	{
+		candidates = Concatenate(consumer_supply_tail, tail);
+		for (var i = Min(cut, consumer_supply_cut); i < Max(cut, consumer_supply_cut); i++)
+		{
+			PushBack(candidates, i);
+		}
+	}
+	balance_nodes_visited += GetLength(candidates);
+	for (var i in candidates)
+	{
+		var supplied = i < cut || is_tail[Format("%d", i)];
+		if (!QueueConsumerSupply(order[i], supplied))
+		{
+			consumer_supply_order = nil;
+		}
+	}
+	consumer_supply_cut = cut;
+	consumer_supply_tail = tail;
+	return power_level;
+}
+
+
+/**
+ * Builds the priority order of the consumers with demand, and the prefix sums
+ * and suffix minimums of their demands. Consumers that do not need power are
+ * kept separately.
+ */
+func BuildConsumerSupplyOrder()
+{
+	consumer_supply_order = [];
+	consumer_demand_prefix = [0];
+	consumers_without_demand = [];
+	var total = 0;
+	for (var consumer in GetPowerConsumers())
+	{
+		if (!consumer)
+		{
+			continue;
+		}
+		var demand = GetPowerAccount(consumer).consumer.demand;
+		if (demand == 0)
+		{
+			PushBack(consumers_without_demand, consumer);
+			continue;
+		}
+		total += demand;
+		PushBack(consumer_supply_order, consumer);
+		PushBack(consumer_demand_prefix, total);
+	}
+	var count = GetLength(consumer_supply_order);
+	consumer_demand_suffix_min = CreateArray(count);
+	for (var i = count - 1; i >= 0; i--)
+	{
+		var demand = consumer_demand_prefix[i + 1] - consumer_demand_prefix[i];
+		if (i < count - 1)
+		{
+			demand = Min(demand, consumer_demand_suffix_min[i + 1]);
+		}
+		consumer_demand_suffix_min[i] = demand;
+	}
+	consumer_supply_cut = 0;
+	consumer_supply_tail = [];
+}
+
+
+/**
+ * Switches a consumer on or off, if its supply changes.
+ *
+ * @return {@c false} if the consumer was removed without unregistering.
+ */
+func QueueConsumerSupply(object consumer, bool supplied)
+{
+	if (!consumer)
+	{
+		return false;
+	}
+	if (consumer->HasEnoughPower() != supplied)
+	{
+		QueuePowerCallback(consumer, POWER_NODE_Consumer, supplied);
+	}
+	return true;
+}
+
+
+/**
+ * Does an update of the power balance once the dwell time of a node has passed.
+ */
+func SchedulePowerDwellRecheck(int delay)
+{
+	var fx = GetEffect("FxPowerDwellRecheck", this);
+	if (fx)
+	{
+		// Keep the earlier recheck.
+		if (fx.Interval - fx.Time <= delay)
+		{
+			return;
+		}
+		fx.Interval = fx.Time + Max(1, delay);
+	}
+	else
+	{
+		CreateEffect(FxPowerDwellRecheck, 1, Max(1, delay));
+	}
+}
+
+local FxPowerDwellRecheck = new Effect {
+	Timer = func ()
+	{
+		Target->SchedulePowerBalanceUpdate();
+		return FX_Execute_Kill;
+	},
+};
+
+
+/**
+ * Returns whether a producer or consumer may be switched again.
+ */
+func HasPowerDwellTimePassed(proplist entry)
+{
+	return GetPowerDwellTimeRemaining(entry) <= 0;
+}
+
+
+func GetPowerDwellTimeRemaining(proplist entry)
+{
+	if (entry.toggle_frame == nil)
+	{
+		return 0;
+	}
+	return entry.toggle_frame + power_min_dwell - FrameCounter();
+}
+
+
+/**
+ * Remembers when a producer or consumer was switched.
+ */
+func RecordPowerToggle(proplist entry)
+{
+	entry.toggle_frame = FrameCounter();
+	power_toggle_count += 1;
+}
+
+
+/**
+ * Switches a producer on or off right away, during the power balance update.
+ * The producer may refuse, so the caller has to check its state afterwards.
+ */
+func SwitchPowerProducer(object producer, bool active)
+{
+	if (DoPowerCallback({node = producer, role = POWER_NODE_Producer, active = active}))
+	{
+		balance_callbacks_done += 1;
+	}
+}
+
+
+/**
+ * Checks the power balance after a change to this network: i.e. removal or addition
+ * of a consumer or producer. The producers are switched right away and their actual
+ * state is checked again, so that consumers and storages get only the power that is
+ * really produced. The callbacks for the consumers and displays are queued, see
+ * DoPowerCallbacks().
+ */
+func DoPowerBalanceUpdate()
+{
+	var found_holes = false;
+	var dwell_recheck = nil;							// frames until a switch that had to wait becomes possible
+
+	var power_level = 0;								// how much is produced?
+	var power_demand = GetPowerConsumptionNeed();		// how much is demanded?
+	var power_capacity = GetStoragePowerCapacity();	// how much can be saved?
+	var lowest_demand = GetLowestPowerConsumption();
+	balance_nodes_visited = 0;
+	balance_callbacks_done = 0;
+
+	GetPowerSystem()->DebugInfo("==========================================================================");
+	GetPowerSystem()->DebugInfo("POWR - Performing power balance update for network %v in frame %d", this, FrameCounter());
+
+	var should_produce_power = GetPowerAvailable() >= lowest_demand;
+
+	GetPowerSystem()->DebugInfo("POWR - Consumers demand %d units", power_demand);
+
+	// Activate producers if necessary
+	for (var bucket in producer_buckets)
+	for (var producer in bucket.nodes)
+	{
+		if (!producer)
+		{
+			found_holes = true;
+			continue;
+		}
+		balance_nodes_visited += 1;
+		var supply = producer->GetPowerProduction();
+		var producer_entry = GetPowerAccount(producer).producer;
+		var is_active = producer->IsPowerProductionActive();
+
+		// Not supplied yet? Switch on the producer, if possible
+		if (should_produce_power && (power_level < power_demand))
+		{
+			// If production can be started
+			if (!is_active && producer->CanPowerProductionStart(Min(power_demand - power_level, supply)))
+			{
+				if (HasPowerDwellTimePassed(producer_entry))
+				{
+					SwitchPowerProducer(producer, true);
+					is_active = producer->IsPowerProductionActive();
+				}
+				else
+				{
+					dwell_recheck = Min(dwell_recheck ?? power_min_dwell, GetPowerDwellTimeRemaining(producer_entry));
+				}
+			}
+		}
+		// All consumers have enough power, so switch off the remaining producers
+		// or the lowest demand cannot be met, so switch all producers off, too
+		else if (power_level >= power_demand + power_capacity + power_hysteresis)
+		{
+			if (is_active && !producer->~IsSteadyPowerProducer())
+			{
+				if (HasPowerDwellTimePassed(producer_entry))
+				{
+					SwitchPowerProducer(producer, false);
+					is_active = producer->IsPowerProductionActive();
+				}
+				else
+				{
+					dwell_recheck = Min(dwell_recheck ?? power_min_dwell, GetPowerDwellTimeRemaining(producer_entry));
+				}
+			}
+		}
+
+		// Production is on?
+		if (is_active)
+		{
+			power_level += supply;
+			GetPowerSystem()->DebugInfo("POWR - %d units created by %s", supply, LogObject(producer));
+		}
+	}
+
+	GetPowerSystem()->DebugInfo("POWR - Producers supply %d units", power_level);
+
+	// Supply the consumers
+	if (power_hysteresis == 0 && power_min_dwell == 0)
+	{
+		power_level = SupplyConsumersByCut(power_level);
+		// The order is dropped if it contained removed consumers.
+		if (consumer_supply_order == nil)
+		{
+			found_holes = true;
+		}
+	}
+	else
+	{
+		// The hysteresis band and dwell time depend on the state of each consumer, so walk all of them.
+		for (var bucket in consumer_buckets)
+		for (var consumer in bucket.nodes)
+		{
+			if (!consumer)
+			{
+				found_holes = true;
+				continue;
+			}
+			balance_nodes_visited += 1;
+			var demand = consumer->GetPowerConsumption();
+			var ignores_power_level = consumer->IsNoPowerNeeded();
+			var consumer_entry = GetPowerAccount(consumer).consumer;
+
+			GetPowerSystem()->DebugInfo("POWR - Demand for %s: %d, current power level %d", LogObject(consumer), demand, power_level);
+
+			// A consumer without power has to wait for the dwell time and needs the hysteresis band on top.
+			var required_level = demand;
+			if (!consumer->HasEnoughPower() && !ignores_power_level)
+			{
+				required_level += power_hysteresis;
+				if (!HasPowerDwellTimePassed(consumer_entry))
+				{
+					dwell_recheck = Min(dwell_recheck ?? power_min_dwell, GetPowerDwellTimeRemaining(consumer_entry));
+					required_level = nil;
+				}
+			}
+
+			// Still enough power for this consumer?
+			if ((required_level != nil && power_level >= required_level) || ignores_power_level)
+			{
+				// Reduce available power
+				if (!ignores_power_level)
+				{
+					power_level -= demand;
+				}
+
+				// Non on? Switch on
+				QueueConsumerSupply(consumer, true);
+				GetPowerSystem()->DebugInfo("POWR - %d units consumed by %s", demand, LogObject(consumer));
+			}
+			// Not enough power
+			else
+			{
+				// Still on? Switch off
+				QueueConsumerSupply(consumer, false);
+			}
+		}
+		consumer_supply_order = nil;
+	}
+
+	// Put the remaining power into storages
+	// This is done separately from supplying consumers, so that storages do not hinder the consumers
+	// Distribution is equal among all power storages, so that as many storages as possible can
+	// produce at the same time
+	GetPowerSystem()->DebugInfo("POWR - Excess energy is %d units", power_level);
+
+	// A storage can take back at most what it supplies and store at most its storage power
+	var storage_count = GetLength(power_storages);
+	var lower_bounds = CreateArray(storage_count);
+	var upper_bounds = CreateArray(storage_count);
+	for (var i = 0; i < storage_count; ++i)
+	{
+		var storage = power_storages[i];
+		if (!storage)
+		{
+			found_holes = true;
+			continue;
+		}
+		balance_nodes_visited += 1;
+		lower_bounds[i] = -storage->GetPowerProduction();
+		upper_bounds[i] = Max(0, Min(storage->GetStoragePower(), storage->GetStorageRemaining() / POWER_SYSTEM_TICK));
+	}
+	var inputs = DistributeExcessPower(power_level, lower_bounds, upper_bounds);
+	for (var i = 0; i < storage_count; ++i)
+	{
+		var storage = power_storages[i];
+		if (!storage)
+		{
+			continue;
+		}
+		// Update remaining power level
+		power_level -= storage->SetStorageInput(inputs[i]) - lower_bounds[i];
+		GetPowerSystem()->DebugInfo("Store %d power in %s", storage->GetStorageInput(), LogObject(storage));
 	}
 
 	GetPowerSystem()->DebugInfo("POWR - Wasted energy is %d units", power_level);
 	GetPowerSystem()->DebugInfo("==========================================================================");
 
+	// Clean up after nodes that were removed without unregistering.
+	if (found_holes)
+	{
+		RebuildPowerIndex();
+	}
+
+	// Check again once the nodes that had to wait may switch.
+	if (dwell_recheck != nil)
+	{
+		SchedulePowerDwellRecheck(dwell_recheck);
+	}
+
+	GetPowerSystem()->CountPowerStatistic(this, "balance_updates", 1);
+	GetPowerSystem()->CountPowerStatistic(this, "nodes_visited", balance_nodes_visited);
 	NotifyOnPowerBalanceChange();
 }
 
 
+/**
+ * Distributes excess power equally among storages, as if every storage got one unit
+ * after the other until the excess is used up or all storages are at their upper bound.
+ *
+ * Instead of handing out single units the fill level, that is the amount every storage
+ * gets unless it reaches its upper bound before, is determined in one sorted pass.
+ * Can be called from definition context.
+ *
+ * @par excess the amount of power to distribute.
+ * @par lower_bounds the input of each storage if it gets nothing from the excess.
+ * @par upper_bounds the maximum input of each storage.
+ *
+ * @return array the input for each storage.
+ */
+public func DistributeExcessPower(int excess, array lower_bounds, array upper_bounds)
+{
+	var count = GetLength(lower_bounds);
+	var spans = CreateArray(count);
+	for (var i = 0; i < count; ++i)
+	{
+		spans[i] = Max(0, upper_bounds[i] - lower_bounds[i]);
+	}
+
+	var fill_level = 0;
+	if (excess > 0 && count > 0)
+	{
+		var sorted_spans = spans[:];
+		SortArray(sorted_spans);
+		// Storages with a smaller span than the fill level are full,
+		// the others all get the same amount.
+		fill_level = sorted_spans[count - 1];
+		var distributed = 0;
+		var previous_span = 0;
+		for (var i = 0; i < count; ++i)
+		{
+			var unfilled = count - i;
+			var step = sorted_spans[i] - previous_span;
+			if (distributed + unfilled * step >= excess)
+			{
+				// Every unit round gives one unit to all unfilled storages, so round up.
+				fill_level = previous_span + (excess - distributed + unfilled - 1) / unfilled;
+				break;
+			}
+			distributed += unfilled * step;
+			previous_span = sorted_spans[i];
+		}
+	}
+
+	var inputs = CreateArray(count);
+	for (var i = 0; i < count; ++i)
+	{
+		inputs[i] = lower_bounds[i] + Min(fill_level, spans[i]);
+	}
+	return inputs;
+}
+
+
 /**
  * Called when the power balance of this network changes: notify other objects depending on this.
  */
 func NotifyOnPowerBalanceChange()
 {
-	// Notify all power display objects a balance change has occured.
-	for (var display_obj in FindObjects(Find_Func("IsPowerDisplay")))
+	// Notify the power displays in this network that a balance change has occured,
+	// after the producers and consumers were switched.
+	for (var display_obj in power_displays)
 	{
-		if (GetPowerSystem()->GetPowerNetwork(display_obj) == this)
+		if (display_obj)
 		{
-			display_obj->~OnPowerBalanceChange(this);
+			QueuePowerCallback(display_obj, POWER_NODE_Display);
 		}
 	}
 }
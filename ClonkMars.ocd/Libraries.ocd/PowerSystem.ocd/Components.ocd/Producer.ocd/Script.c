@@ -51,6 +51,12 @@ func SetPowerProduction(int amount)
 		FatalError(Format("Power production must be >= 0, was %d", amount));
 	}
 
+	// Nothing to do for the network if the production does not change.
+	if (amount == GetPowerProduction())
+	{
+		return _inherited(amount, ...);
+	}
+
 	// Callback to visualization
 	if (IsPowerProductionActive())
 	{
@@ -59,7 +65,7 @@ func SetPowerProduction(int amount)
 
 	// Update
 	lib_power_system.producer.power_production = amount;
-	GetPowerSystem()->UpdateNetworkForPowerLink(this);
+	GetPowerSystem()->UpdateNetworkForPowerLink(this, "production_change");
 
 	// Let parent class handle things
 	_inherited(amount, ...);
@@ -100,7 +106,7 @@ func SetProducerPriority(int priority)
 	}
 
 	lib_power_system.producer.priority = priority;
-	GetPowerSystem()->UpdateNetworkForPowerLink(this);
+	GetPowerSystem()->UpdatePriorityForPowerLink(this);
 }
 
 
@@ -152,7 +158,9 @@ public func IsPowerProductionActive()
  */
 public func SetPowerProductionActive(bool status)
 {
-	return lib_power_system.producer.is_producing_power = status;
+	lib_power_system.producer.is_producing_power = status;
+	GetPowerSystem()->UpdateNetworkTotalsForPowerLink(this);
+	return status;
 }
 
 
@@ -256,6 +264,6 @@ func Destruction()
  */
 func OnOwnerChanged(int new_owner, int old_owner)
 {
-	GetPowerSystem()->TransferPowerLink(this);
+	GetPowerSystem()->TransferPowerLink(this, "owner_change");
 	return _inherited(new_owner, old_owner, ...);
 }
@@ -43,6 +43,7 @@ func SetStoredPower(int to_power)
 	// Determine change
 	var old_power = GetStoredPower();
 	lib_power_system.storage.stored_power = BoundBy(to_power, 0, GetStorageCapacity());
+	lib_power_system.storage.charge_frame = FrameCounter();
 	var change = GetStoredPower() - old_power;
 
 	// Register / unregister power production
@@ -50,6 +51,8 @@ func SetStoredPower(int to_power)
 	var production = BoundBy((GetStoredPower() - remainder) / POWER_SYSTEM_TICK, 0, GetStoragePower());
 	RegisterPowerProduction(production);
 
+	GetPowerSystem()->UpdateNetworkChargeForPowerLink(this);
+
 	// Callback to this object that the power has changed.
 	if (change != 0)
 	{
@@ -61,10 +64,14 @@ func SetStoredPower(int to_power)
 
 /**
  * Returns the amount of stored power in the storage.
+ *
+ * The storage input is constant between two balance updates, so the
+ * stored power is calculated from the last known value and the input.
  */
 func GetStoredPower()
 {
-	return lib_power_system.storage.stored_power;
+	var elapsed = FrameCounter() - lib_power_system.storage.charge_frame;
+	return BoundBy(lib_power_system.storage.stored_power + lib_power_system.storage.input * elapsed, 0, GetStorageCapacity());
 }
 
 
@@ -103,7 +110,14 @@ func SetStorageInput(int amount)
 {
 	var rate = BoundBy(amount, -GetPowerProduction(), GetStoragePower()); // can at least put in as much as is put out
 
-	lib_power_system.storage.input = rate;
+	// Remember what was stored with the previous input.
+	if (rate != GetStorageInput())
+	{
+		lib_power_system.storage.stored_power = GetStoredPower();
+		lib_power_system.storage.charge_frame = FrameCounter();
+		lib_power_system.storage.input = rate;
+		GetPowerSystem()->UpdateNetworkChargeForPowerLink(this);
+	}
 	CheckCharge();
 	return rate;
 }
@@ -132,10 +146,93 @@ func GetStorageInput()
 }
 
 
+/**
+ * Wakes up the storage in the next power tick, so that it can
+ * issue the callbacks for the changed input.
+ */
 func CheckCharge()
 {
 	var fx = GetEffect("FxStorageCharge", this);
-	if (!fx) CreateEffect(FxStorageCharge, 1, POWER_SYSTEM_TICK);
+	if (fx)
+	{
+		fx.Interval = fx.Time + POWER_SYSTEM_TICK;
+	}
+	else
+	{
+		CreateEffect(FxStorageCharge, 1, POWER_SYSTEM_TICK);
+	}
+}
+
+
+/**
+ * Updates the stored power, production and callbacks of the storage.
+ *
+ * @return the number of frames until the production changes, or the
+ *         storage is full or empty. Returns nil if the storage is idle.
+ */
+func UpdateStorageCharge()
+{
+	var storage = lib_power_system.storage;
+	var old_power = storage.stored_power;
+	SetStoredPower(GetStoredPower());
+	if (GetStoredPower() != old_power)
+	{
+		OnStoredPowerChange();
+	}
+
+	// The input has no effect if the storage is full or empty.
+	var rate = GetStorageInput();
+	if ((rate > 0 && GetStorageRemaining() == 0) || (rate < 0 && GetStoredPower() == 0))
+	{
+		rate = 0;
+	}
+
+	if (rate > 0)
+	{
+		if (!storage.is_storing)
+		{
+			storage.is_storing = true;
+			OnStorageStart();
+		}
+		if (storage.is_producing)
+		{
+			storage.is_producing = false;
+			OnPowerProductionStop();
+		}
+	}
+	else
+	{
+		if (storage.is_storing)
+		{
+			storage.is_storing = false;
+			OnStorageStop();
+		}
+		if (!storage.is_producing && rate < 0)
+		{
+			storage.is_producing = true;
+			OnPowerProductionStart();
+		}
+	}
+
+	// The production follows the stored power while it is less than the storage power.
+	var full_production = GetStoragePower() * POWER_SYSTEM_TICK;
+	if (rate > 0)
+	{
+		if (GetStoredPower() < full_production)
+		{
+			return 1;
+		}
+		return (GetStorageRemaining() + rate - 1) / rate;
+	}
+	if (rate < 0)
+	{
+		if (GetStoredPower() < full_production)
+		{
+			return 1;
+		}
+		return (GetStoredPower() - full_production) / -rate + 1;
+	}
+	return nil;
 }
 
 
@@ -189,7 +286,8 @@ func OnStorageStart()
 func OnStorageStop()
 {
 	GetPowerSystem()->DebugInfo("Stop charging frame %d, %s (%d)", FrameCounter(), GetName(), ObjectNumber());
-	GetPowerSystem()->RefreshAllPowerNetworks();
+	// The network does not change, only the excess power has to be distributed again.
+	GetPowerSystem()->UpdateNetworkForPowerLink(this, "storage_stop");
 	return _inherited(...);
 }
 
@@ -225,6 +323,7 @@ func Construction()
 	lib_power_system.storage.max_rate = 0;		// Do not store by default
 	lib_power_system.storage.input = 0;			// Do not store by default
 	lib_power_system.storage.stored_power = 0; 	// Empty by default
+	lib_power_system.storage.charge_frame = 0;	// Frame in which the stored power was last updated
 	lib_power_system.storage.capacity = 0;		// Cannot store anything by default
 	return _inherited(...);
 }
@@ -246,7 +345,7 @@ func Destruction()
  */
 func OnOwnerChanged(int new_owner, int old_owner)
 {
-	GetPowerSystem()->TransferPowerLink(this);
+	GetPowerSystem()->TransferPowerLink(this, "owner_change");
 	return _inherited(new_owner, old_owner, ...);
 }
 
@@ -260,50 +359,20 @@ func IsSteadyPowerProducer()
 }
 
 
+/**
+ * Wakes up the storage only when something changes: in the next power tick after
+ * a new input, when the production changes and when the storage is full or empty.
+ */
 local FxStorageCharge = new Effect
 {
-	Construction = func()
-	{
-		this.is_storing = false;
-	},
-
 	Timer = func ()
 	{
-		var expected_change = Target->GetStorageInput() * this.Interval;
-		var actual_change = 0;
-		actual_change = Target->SetStoredPower(Target->GetStoredPower() + expected_change);
-
-		if (actual_change > 0)
-		{
-			if (!this.is_storing)
-			{
-				this.is_storing = true;
-				Target->OnStorageStart();
-			}
-			if (this.is_producing)
-			{
-				this.is_producing = false;
-				Target->OnPowerProductionStop();
-			}
-		}
-		else
-		{
-			if (this.is_storing)
-			{
-				this.is_storing = false;
-				Target->OnStorageStop();
-			}
-			if (!this.is_producing && actual_change < 0)
-			{
-				this.is_producing = true;
-				Target->OnPowerProductionStart();
-			}
-		}
-
-		if (actual_change != expected_change) //expected_change == 0 || actual_change < expected_change)
+		var delay = Target->UpdateStorageCharge();
+		if (delay == nil)
 		{
 			return FX_Execute_Kill;
 		}
+		// The timer is called whenever the effect time is a multiple of the interval.
+		this.Interval = this.Time + delay;
 	},
 };
-
@@ -1,5 +1,108 @@
 
 public func GetPowerLink(object for_obj)
 {
-	return FindObject(Find_Func("IsPowerLine"), Find_Func("IsConnectedTo", for_obj));
+	// The power lines keep an index of the objects they are attached to.
+	for (var line in PowerLine->GetAttachedLines(for_obj))
+	{
+		if (line && line->IsPowerLine())
+		{
+			return line;
+		}
+	}
+}
+
+
+public func GetPowerLinksOfNetwork(object network)
+{
+	// Every line knows the other lines of its component.
+	for (var line in FindObjects(Find_Func("IsPowerLine")))
+	{
+		if (line->GetPowerHelper() == network)
+		{
+			return Concatenate([line], line->GetLinkedObjects());
+		}
+	}
+	return [];
+}
+
+
+public func ReleasePowerLinks(array networks)
+{
+	var is_loaded = {};
+	for (var network in networks)
+	{
+		if (network)
+		{
+			is_loaded[Format("%d", network->ObjectNumber())] = true;
+		}
+	}
+	// The helpers of the lines are not saved, so a line gets a new one if a node asks for its network while loading.
+	for (var line in FindObjects(Find_Func("IsPowerLine")))
+	{
+		var helper = line->GetPowerHelper();
+		if (helper && !is_loaded[Format("%d", helper->ObjectNumber())])
+		{
+			line->RestoreLineComponent([line], nil);
+			GetPowerSystem()->RefreshPowerNetworkMembers(helper);
+		}
+	}
+	GetPowerSystem()->InvalidatePowerNetworkCache();
+}
+
+
+public func RestorePowerLinks(object network, array links)
+{
+	if (!links || GetLength(links) == 0)
+	{
+		return false;
+	}
+	var is_saved = {};
+	// The lines were released before, so a line with another helper was taken by another saved network.
+	for (var line in links)
+	{
+		if (!line || !line->IsPowerLine() || (line->GetPowerHelper() && line->GetPowerHelper() != network))
+		{
+			return false;
+		}
+		is_saved[Format("%d", line->ObjectNumber())] = true;
+	}
+	// The saved lines are still a component if no other line is attached to their ends.
+	for (var line in links)
+	for (var end in [line->GetActionTarget(0), line->GetActionTarget(1), line.pipe_kit])
+	{
+		for (var other in PowerLine->GetAttachedLines(end))
+		{
+			if (other && other->IsPowerLine() && !is_saved[Format("%d", other->ObjectNumber())])
+			{
+				return false;
+			}
+		}
+	}
+	// The component array is shared by all its lines.
+	var component = links[:];
+	for (var line in component)
+	{
+		line->RestoreLineComponent(component, network);
+	}
+	GetPowerSystem()->InvalidatePowerNetworkCache();
+	return true;
+}
+
+
+public func CheckPowerLinks()
+{
+	for (var line in FindObjects(Find_Func("IsPowerLine")))
+	{
+		if (!line->GetPowerHelper())
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+
+public func RefreshPowerLinks()
+{
+	PowerLine->RefreshAllLineNetworks();
 }
@@ -45,9 +45,53 @@ static POWER_SYSTEM_NETWORKS;
 // A static variable that handles debug information being logged.
 static POWER_SYSTEM_DEBUG;
 
+// A static variable that holds the neutral network, there is at most one.
+static POWER_SYSTEM_NEUTRAL_NETWORK;
+
+// A static variable that is increased whenever the links between nodes and networks change.
+// Nodes cache their network and resolve it again only if this changed.
+static POWER_SYSTEM_TOPOLOGY_EPOCH;
+
+// Static variables that hold the nodes and networks whose membership has to be refreshed.
+// They are keyed by object number, so that marking an object twice does not search the list.
+static POWER_SYSTEM_DIRTY_NODES;
+static POWER_SYSTEM_DIRTY_NETWORKS;
+
+// A static variable that holds the networks loaded from a scenario save, until their topology is restored.
+static POWER_SYSTEM_LOADED_NETWORKS;
+
+// A static variable that holds the networks that wait for a power balance update, oldest first.
+// The entries before the head were updated already, they are dropped once they make up half of the queue.
+static POWER_SYSTEM_BALANCE_QUEUE;
+static POWER_SYSTEM_BALANCE_QUEUE_HEAD;
+
+// A static variable that limits the callbacks of power balance updates per frame.
+static POWER_SYSTEM_BALANCE_BUDGET;
+static const POWER_SYSTEM_BALANCE_BUDGET_DEFAULT = 100;
+
+// A static variable that holds the counters of all networks together, see GetPowerStatistics.
+static POWER_SYSTEM_STATISTICS;
+
 // A static variable that handles the interval in which storages are drained, in frames.
 static const POWER_SYSTEM_TICK = 1;
 
+// The number of frames in one second of game time, at the default game speed.
+static const POWER_SYSTEM_FramesPerSecond = 36;
+
+// The power history of a network: one value every interval, in frames, and the number of values that are kept.
+static const POWER_SYSTEM_HISTORY_Interval = 36;
+static const POWER_SYSTEM_HISTORY_Length = 60;
+
+// Role tags of a node in the membership index of a network.
+static const POWER_NODE_Producer = 1;
+static const POWER_NODE_Consumer = 2;
+static const POWER_NODE_Storage = 4;
+static const POWER_NODE_Display = 8;
+
+// The running totals of a network that the storages contribute to. The charge is moved separately,
+// because it is anchored at the frame where it was booked.
+static const POWER_SYSTEM_STORAGE_TOTALS = ["storage_rate", "capacity"];
+
 /**
  * Getter for the power system
  *
@@ -157,11 +201,47 @@ public func UnregisterPowerStorage(object storage)
 }
 
 
+/**
+ * Definition call: registers a power display, so that it is notified
+ * when the power balance of its network changes.
+ */
+public func RegisterPowerDisplay(object display)
+{
+	// Definition call safety checks.
+	if (this != GetPowerSystem() || !display || !display->~IsPowerDisplay())
+	{
+		return FatalError("RegisterPowerDisplay() either not called from definition context or no display specified.");
+	}
+	GetPowerSystem()->Init();
+	GetPowerNetwork(display)->AddPowerDisplay(display);
+	return;
+}
+
+
+/**
+ * Definition call: unregisters a power display.
+ */
+public func UnregisterPowerDisplay(object display)
+{
+	// Definition call safety checks.
+	if (this != GetPowerSystem() || !display || !display->~IsPowerDisplay())
+	{
+		return FatalError("UnregisterPowerDisplay() either not called from definition context or no display specified.");
+	}
+	GetPowerSystem()->Init();
+	GetPowerNetwork(display)->RemovePowerDisplay(display);
+	return;
+}
+
+
 /**
  * Definition call: transfers a power link from the network it is registered in to
  * the network it is currently in (base radius).
+ *
+ * @return object the network that the link was transferred from, or nil
+ *                if the link was not transferred.
  */
-public func TransferPowerLink(object link)
+public func TransferPowerLink(object link, string reason)
 {
 	// Definition call safety checks.
 	if (this != GetPowerSystem() || !link)
@@ -172,19 +252,13 @@ public func TransferPowerLink(object link)
 	DebugInfo("**************************************************************************");
 	DebugInfo("POWR - Transfer power link for %v", link);
 
+	// The owner may have changed, so the cached network is not reliable.
+	InvalidatePowerNetworkCache();
 
+	// Find the network that the link is registered in, before the cache is replaced.
+	var old_network = GetRegisteredPowerNetwork(link);
 	// Get the new network for this power link.
 	var new_network = GetPowerNetwork(link);
-	// Loop over existing networks and find the link.
-	var old_network;
-	for (var network in POWER_SYSTEM_NETWORKS)
-	{
-		if (network && network->ContainsPowerLink(link))
-		{
-			old_network = network;
-			break;
-		}
-	}
 	// Only perform a transfer if the link was registered in an old network which is not equal to the new network.
 	if (old_network && old_network != new_network)
 	{
@@ -206,75 +280,475 @@ public func TransferPowerLink(object link)
 			old_network->RemovePowerStorage(storage);
 			new_network->AddPowerStorage(storage);	
 		}
+		var display = old_network->GetDisplayLink(link);
+		if (display)
+		{
+			old_network->RemovePowerDisplay(display);
+			new_network->AddPowerDisplay(display);
+		}
 	}
 	GetPowerSystem()->DebugInfo("**************************************************************************");
+	if (old_network != new_network)
+	{
+		if (reason)
+		{
+			CountPowerRefresh(reason, new_network);
+		}
+		return old_network;
+	}
 }
 
 
 /**
- * Definition call: Refreshes all power networks
- * in the next frame. This ensures that the networks
- * have the correct state.
+ * Definition call: returns the network that a power link is registered in.
+ */
+public func GetRegisteredPowerNetwork(object link)
+{
+	// The cached network is usually the one that the link registered in.
+	var node_data = link.lib_power_system;
+	if (node_data && node_data.network && node_data.network->ContainsPowerLink(link))
+	{
+		return node_data.network;
+	}
+	// Loop over existing networks and find the link, the membership test is constant time.
+	for (var network in POWER_SYSTEM_NETWORKS)
+	{
+		if (network && network->ContainsPowerLink(link))
+		{
+			return network;
+		}
+	}
+}
+
+
+/**
+ * Definition call: Refreshes the members of all power networks in the next frame.
+ * Kept for the flag library, which calls this when the flag links change. Prefer
+ * RefreshPowerNode() or RefreshPowerNetworkMembers() for the objects that changed.
  */
 public func RefreshAllPowerNetworks()
 {
-	if (!GetEffect("FxUpdateAllPowerNetworks", Scenario))
-		Scenario->CreateEffect(FxUpdateAllPowerNetworks, 1, 1);
+	Init();
+	for (var network in POWER_SYSTEM_NETWORKS)
+	{
+		if (network)
+		{
+			RefreshPowerNetworkMembers(network);
+		}
+	}
+}
+
+
+/**
+ * Definition call: Refreshes the network of a single node in the next frame.
+ * Call this when the link or owner of the node changed, only the networks
+ * that the node leaves or joins are checked for their power balance.
+ */
+public func RefreshPowerNode(object node, string reason)
+{
+	// Definition call safety checks.
+	if (this != GetPowerSystem() || !node)
+	{
+		return FatalError("RefreshPowerNode() either not called from definition context or no node specified.");
+	}
+	Init();
+	var key = Format("%d", node->ObjectNumber());
+	if (!POWER_SYSTEM_DIRTY_NODES[key])
+	{
+		POWER_SYSTEM_DIRTY_NODES[key] = node;
+		CountPowerRefresh(reason ?? "node");
+	}
+	ScheduleDirtyRefresh();
+}
+
+
+/**
+ * Definition call: Refreshes the members of a single network in the next frame.
+ * Call this when the links of the network changed, for example because a power
+ * line was removed. Empty networks are removed during the refresh.
+ */
+public func RefreshPowerNetworkMembers(object network)
+{
+	// Definition call safety checks.
+	if (this != GetPowerSystem() || !network)
+	{
+		return FatalError("RefreshPowerNetworkMembers() either not called from definition context or no network specified.");
+	}
+	Init();
+	POWER_SYSTEM_DIRTY_NETWORKS[Format("%d", network->ObjectNumber())] = network;
+	ScheduleDirtyRefresh();
+}
+
+
+func ScheduleDirtyRefresh()
+{
+	if (!GetEffect("FxRefreshDirtyPowerNodes", Scenario))
+		Scenario->CreateEffect(FxRefreshDirtyPowerNodes, 1, 1);
 }
 
 
-local FxUpdateAllPowerNetworks = new Effect {
+local FxRefreshDirtyPowerNodes = new Effect {
 	Timer = func ()
 	{
-		GetPowerSystem()->DoRefreshAllPowerNetworks();
+		GetPowerSystem()->DoRefreshDirtyPowerNodes();
 		return FX_Execute_Kill;
 	},
 };
 
 
-func DoRefreshAllPowerNetworks()
+func DoRefreshDirtyPowerNodes()
 {
-	// Don't do anything if there are no power helpers created yet.
-	if (GetType(POWER_SYSTEM_NETWORKS) != C4V_Array) return;
+	// Networks from a scenario save are restored before anything else, so that the refresh finds the nodes in place.
+	if (GetLength(POWER_SYSTEM_LOADED_NETWORKS))
+	{
+		DoRestorePowerNetworks();
+	}
 
-	// Special handling for neutral networks of which there should be at most one.
-	var neutral_network_count = 0;
+	// Networks that lost nodes during the refresh, these may be empty now.
+	var touched_networks = [];
 
-	// Do the same for all other helpers: delete / refresh.
-	for (var index = GetLength(POWER_SYSTEM_NETWORKS) - 1; index >= 0; index--)
+	// Refreshing may create new networks, which are marked dirty again. So keep going until everything is clean.
+	while (GetLength(GetProperties(POWER_SYSTEM_DIRTY_NODES)) || GetLength(GetProperties(POWER_SYSTEM_DIRTY_NETWORKS)))
 	{
-		var network = POWER_SYSTEM_NETWORKS[index];
-		if (!network)
+		var dirty_networks = POWER_SYSTEM_DIRTY_NETWORKS;
+		var dirty_nodes = POWER_SYSTEM_DIRTY_NODES;
+		POWER_SYSTEM_DIRTY_NETWORKS = {};
+		POWER_SYSTEM_DIRTY_NODES = {};
+
+		for (var network_key in GetProperties(dirty_networks))
 		{
-			continue;
+			var network = dirty_networks[network_key];
+			if (network)
+			{
+				RefreshPowerNetwork(network);
+				PushBack(touched_networks, network);
+			}
 		}
+		for (var node_key in GetProperties(dirty_nodes))
+		{
+			var node = dirty_nodes[node_key];
+			if (node)
+			{
+				var old_network = TransferPowerLink(node);
+				if (old_network)
+				{
+					PushBack(touched_networks, old_network);
+				}
+			}
+		}
+	}
 
-		if (network->IsEmpty())
+	// Remove the networks that have no nodes anymore. Adding and removing nodes
+	// already scheduled a balance update for the networks that were changed.
+	for (var network in touched_networks)
+	{
+		if (network && network->IsEmpty())
 		{
+			var index = GetIndexOf(POWER_SYSTEM_NETWORKS, network);
+			if (index != -1)
+			{
+				RemoveArrayIndex(POWER_SYSTEM_NETWORKS, index);
+			}
 			network->RemoveObject();
-			RemoveArrayIndex(POWER_SYSTEM_NETWORKS, index);
+		}
+	}
+}
+
+
+/**
+ * Definition call: Queues the power balance update of a network.
+ * Call Library_PowerSystem_Network::SchedulePowerBalanceUpdate() instead.
+ *
+ * The networks are updated in the order in which they were queued. Each frame
+ * the updates may cause at most as many callbacks as the budget allows, see
+ * SetPowerBalanceBudget(). The callbacks that do not fit are done in the
+ * next frames, before any other network is updated. Only the producers that
+ * an update switches can exceed the budget, because they are part of the update.
+ */
+public func QueuePowerBalanceUpdate(object network)
+{
+	// Definition call safety checks.
+	if (this != GetPowerSystem() || !network)
+	{
+		return FatalError("QueuePowerBalanceUpdate() either not called from definition context or no network specified.");
+	}
+	Init();
+	PushBack(POWER_SYSTEM_BALANCE_QUEUE, network);
+	if (!GetEffect("FxPowerBalanceScheduler", Scenario))
+		Scenario->CreateEffect(FxPowerBalanceScheduler, 1, 1);
+}
+
+
+local FxPowerBalanceScheduler = new Effect {
+	Timer = func ()
+	{
+		if (GetPowerSystem()->DoScheduledPowerBalanceUpdates())
+		{
+			return FX_OK;
+		}
+		return FX_Execute_Kill;
+	},
+};
+
+
+/**
+ * Updates the queued networks, oldest first, until the budget is used up.
+ * Every network gets only the budget that is left, so a network that does not
+ * finish stays at the head of the queue and goes on in the next frame.
+ *
+ * @return {@c true} if networks are left for the next frame.
+ */
+func DoScheduledPowerBalanceUpdates()
+{
+	var budget = POWER_SYSTEM_BALANCE_BUDGET;
+	var work = 0;
+	var time = GetTime();
+	var work_of_networks = [];
+	while (POWER_SYSTEM_BALANCE_QUEUE_HEAD < GetLength(POWER_SYSTEM_BALANCE_QUEUE) && work < budget)
+	{
+		var network = POWER_SYSTEM_BALANCE_QUEUE[POWER_SYSTEM_BALANCE_QUEUE_HEAD];
+		if (network)
+		{
+			var network_work = network->RunPowerBalanceUpdate(budget - work);
+			work += network_work;
+			PushBack(work_of_networks, [network, network_work]);
+			// Callbacks are left, because the budget is used up.
+			if (network->IsPowerBalanceQueued())
+			{
+				break;
+			}
+		}
+		POWER_SYSTEM_BALANCE_QUEUE[POWER_SYSTEM_BALANCE_QUEUE_HEAD] = nil;
+		POWER_SYSTEM_BALANCE_QUEUE_HEAD += 1;
+	}
+	if (work > budget)
+	{
+		// Switching the producers is part of an update, so it is not split.
+		DebugInfo("POWR - Power balance updates exceeded the budget of %d by %d in frame %d", budget, work - budget, FrameCounter());
+	}
+	CompactPowerBalanceQueue();
+	CountPowerBalanceTime(GetTime() - time, work_of_networks, work);
+	return POWER_SYSTEM_BALANCE_QUEUE_HEAD < GetLength(POWER_SYSTEM_BALANCE_QUEUE);
+}
+
+
+// Drops the updated networks from the front of the queue, once they make up half of it.
+func CompactPowerBalanceQueue()
+{
+	var length = GetLength(POWER_SYSTEM_BALANCE_QUEUE);
+	if (POWER_SYSTEM_BALANCE_QUEUE_HEAD >= length)
+	{
+		POWER_SYSTEM_BALANCE_QUEUE = [];
+		POWER_SYSTEM_BALANCE_QUEUE_HEAD = 0;
+	}
+	else if (2 * POWER_SYSTEM_BALANCE_QUEUE_HEAD >= length)
+	{
+		POWER_SYSTEM_BALANCE_QUEUE = POWER_SYSTEM_BALANCE_QUEUE[POWER_SYSTEM_BALANCE_QUEUE_HEAD:];
+		POWER_SYSTEM_BALANCE_QUEUE_HEAD = 0;
+	}
+}
+
+
+// Counts the time of all balance updates in a frame. A single update mostly takes less than
+// a millisecond, so the time is measured for the whole frame and spread over the networks by
+// their share of the work. The rounding remainder goes to the first network.
+func CountPowerBalanceTime(int time, array work_of_networks, int work)
+{
+	CountPowerStatistic(nil, "time", time);
+	if (time <= 0 || work <= 0 || GetLength(work_of_networks) == 0)
+	{
+		return;
+	}
+	var remainder = time;
+	for (var entry in work_of_networks)
+	{
+		var share = time * entry[1] / work;
+		remainder -= share;
+		if (entry[0] && entry[0].power_stats)
+		{
+			entry[0].power_stats.time += share;
+		}
+	}
+	var first = work_of_networks[0][0];
+	if (first && first.power_stats)
+	{
+		first.power_stats.time += remainder;
+	}
+}
+
+
+/**
+ * Definition call: Sets how many callbacks the power balance updates
+ * may cause per frame, before the rest is done in the next frames.
+ */
+public func SetPowerBalanceBudget(int budget)
+{
+	Init();
+	POWER_SYSTEM_BALANCE_BUDGET = Max(1, budget);
+}
+
+
+/**
+ * Definition call: Returns how many callbacks the power balance updates may cause per frame.
+ */
+public func GetPowerBalanceBudget()
+{
+	Init();
+	return POWER_SYSTEM_BALANCE_BUDGET;
+}
+
+
+/**
+ * Definition call: Returns how far behind the power balance updates are.
+ *
+ * @return proplist with the entries
+ *         - networks: the number of networks that wait for an update
+ *         - callbacks: the number of callbacks that wait, from updates that did not fit into the budget
+ *         - frames: the number of frames that the oldest network waits already
+ */
+public func GetPowerBalanceBacklog()
+{
+	Init();
+	var backlog = {networks = 0, callbacks = 0, frames = 0};
+	for (var network in POWER_SYSTEM_BALANCE_QUEUE[POWER_SYSTEM_BALANCE_QUEUE_HEAD:])
+	{
+		if (!network || !network->IsPowerBalanceQueued())
+		{
 			continue;
 		}
+		backlog.networks += 1;
+		backlog.callbacks += network->GetPendingPowerCallbackCount();
+		backlog.frames = Max(backlog.frames, FrameCounter() - network->GetPowerBalanceQueuedFrame());
+	}
+	return backlog;
+}
+
+
+/**
+ * Definition call: restores a network from a scenario save, together with
+ * the next refresh. See Library_PowerSystem_Network::SavePowerTopology().
+ */
+public func RestorePowerNetwork(object network)
+{
+	// Definition call safety checks.
+	if (this != GetPowerSystem() || !network)
+	{
+		return FatalError("RestorePowerNetwork() either not called from definition context or no network specified.");
+	}
+	Init();
+	if (GetIndexOf(POWER_SYSTEM_NETWORKS, network) == -1)
+	{
+		PushBack(POWER_SYSTEM_NETWORKS, network);
+	}
+	PushBack(POWER_SYSTEM_LOADED_NETWORKS, network);
+	// The nodes may have been loaded with a cached network and epoch from before the save.
+	InvalidatePowerNetworkCache();
+	RefreshPowerNetworkMembers(network);
+}
 
-		RefreshPowerNetwork(network);
-		if (network->IsNeutral())
+
+func DoRestorePowerNetworks()
+{
+	var networks = POWER_SYSTEM_LOADED_NETWORKS;
+	POWER_SYSTEM_LOADED_NETWORKS = [];
+	var is_consistent = true;
+
+	DebugInfo("**************************************************************************");
+	DebugInfo("POWR - Restoring %d saved power networks", GetLength(networks));
+
+	// The saved neutral network replaces the one that the nodes registered in while loading.
+	for (var network in networks)
+	{
+		if (network && network.saved_topology && network.saved_topology.neutral)
 		{
-			neutral_network_count += 1;
+			var previous = POWER_SYSTEM_NEUTRAL_NETWORK;
+			if (previous && previous != network)
+			{
+				previous->SetNeutral(false);
+				RefreshPowerNetworkMembers(previous);
+			}
+			POWER_SYSTEM_NEUTRAL_NETWORK = network;
+			network->SetNeutral(true);
+			InvalidatePowerNetworkCache();
+			break;
 		}
 	}
 
-	if (neutral_network_count > 1)
+	// The links may have got a network while loading already, the saved networks take them over.
+	ReleasePowerLinks(networks);
+	for (var network in networks)
 	{
-		FatalError(Format("There were a total of %d neutral networks, at most there should be one", neutral_network_count));
+		if (network && !network->RestorePowerTopology())
+		{
+			is_consistent = false;
+		}
 	}
 
-	// Schedule an update, too, because the network nodes may have changed
-	RemoveHoles(POWER_SYSTEM_NETWORKS);
-	for (var network in POWER_SYSTEM_NETWORKS)
+	// Links that did not match their saved network are grouped again.
+	if (!is_consistent || !CheckPowerLinks())
 	{
-		network->SchedulePowerBalanceUpdate();
+		DebugInfo("POWR - Saved power networks do not match the power links, refreshing the links");
+		RefreshPowerLinks();
 	}
-	return;
+	DebugInfo("**************************************************************************");
+}
+
+
+/**
+ * Definition call: Returns the links that form a network, for saving its topology.
+ *
+ * Is defined by the plugins.
+ */
+func GetPowerLinksOfNetwork(object network)
+{
+	return _inherited(network, ...) ?? [];
+}
+
+
+/**
+ * Definition call: Releases the links from the networks that they got while
+ * loading, so that the saved networks can take them over. Links that are in
+ * one of the given networks are kept.
+ *
+ * Is defined by the plugins.
+ */
+func ReleasePowerLinks(array networks)
+{
+	return _inherited(networks, ...);
+}
+
+
+/**
+ * Definition call: Gives the saved links of a network back to it, if they still
+ * form that network. Returns whether the links were consistent.
+ *
+ * Is defined by the plugins.
+ */
+func RestorePowerLinks(object network, array links)
+{
+	return _inherited(network, links, ...);
+}
+
+
+/**
+ * Definition call: Returns whether all links have a network.
+ *
+ * Is defined by the plugins.
+ */
+func CheckPowerLinks()
+{
+	return _inherited(...);
+}
+
+
+/**
+ * Definition call: Finds the networks of all links again.
+ *
+ * Is defined by the plugins.
+ */
+func RefreshPowerLinks()
+{
+	return _inherited(...);
 }
 
 
@@ -290,14 +764,72 @@ func RefreshPowerNetwork(object network)
 /**
  * Definition call: updates the network for this power link.
  */
-public func UpdateNetworkForPowerLink(object link)
+public func UpdateNetworkForPowerLink(object link, string reason)
 {
 	// Definition call safety checks.
 	if (this != GetPowerSystem() || !link)
 	{
 		return FatalError("UpdateNetworkForPowerLink() either not called from definition context or no link specified.");
 	}
-	GetPowerNetwork(link)->SchedulePowerBalanceUpdate();
+	var network = GetPowerNetwork(link);
+	// Only check the balance if the node contributes something else now.
+	if (network->UpdatePowerAccount(link))
+	{
+		CountPowerRefresh(reason ?? "node_change", network);
+		network->SchedulePowerBalanceUpdate();
+	}
+	return;
+}
+
+
+/**
+ * Definition call: updates the running totals of the network for this power link,
+ * without checking the power balance. Used for state changes that the network
+ * causes itself, such as production starting or consumers being supplied.
+ */
+public func UpdateNetworkTotalsForPowerLink(object link)
+{
+	// Definition call safety checks.
+	if (this != GetPowerSystem() || !link)
+	{
+		return FatalError("UpdateNetworkTotalsForPowerLink() either not called from definition context or no link specified.");
+	}
+	GetPowerNetwork(link)->UpdatePowerAccount(link);
+	return;
+}
+
+
+/**
+ * Definition call: updates the stored power and capacity of the network
+ * for this storage, without checking the power balance.
+ */
+public func UpdateNetworkChargeForPowerLink(object link)
+{
+	// Definition call safety checks.
+	if (this != GetPowerSystem() || !link)
+	{
+		return FatalError("UpdateNetworkChargeForPowerLink() either not called from definition context or no link specified.");
+	}
+	GetPowerNetwork(link)->UpdatePowerStorageCharge(link);
+	return;
+}
+
+
+/**
+ * Definition call: moves the power link to the correct position
+ * in the network, after its priority changed.
+ */
+public func UpdatePriorityForPowerLink(object link)
+{
+	// Definition call safety checks.
+	if (this != GetPowerSystem() || !link)
+	{
+		return FatalError("UpdatePriorityForPowerLink() either not called from definition context or no link specified.");
+	}
+	var network = GetPowerNetwork(link);
+	network->UpdatePowerPriority(link);
+	CountPowerRefresh("priority_change", network);
+	network->SchedulePowerBalanceUpdate();
 	return;
 }
 
@@ -315,6 +847,13 @@ public func GetPowerNetwork(object for_obj)
 
 	Init();
 
+	// The network is cached in the node, as long as no links changed.
+	var node_data = for_obj.lib_power_system;
+	if (node_data && node_data.network && node_data.network_epoch == POWER_SYSTEM_TOPOLOGY_EPOCH)
+	{
+		return node_data.network;
+	}
+
 	// Get the actual power consumer for this object. This can for example be the elevator for the case.
 	var actual;
 	while (actual = for_obj->~GetActualPowerConsumer())
@@ -346,15 +885,7 @@ public func GetPowerNetwork(object for_obj)
 	// Otherwise, if no link was available the object is neutral and needs a neutral helper.
 	else
 	{
-		for (var network in POWER_SYSTEM_NETWORKS)
-		{
-			if (!network || !network->IsNeutral())
-			{
-				continue;
-			}
-			helper = network;
-			break;
-		}
+		helper = POWER_SYSTEM_NEUTRAL_NETWORK;
 		// Create the helper if it does not exist yet.
 		if (helper == nil)
 		{
@@ -362,10 +893,25 @@ public func GetPowerNetwork(object for_obj)
 		}
 	}
 
+	if (node_data)
+	{
+		node_data.network = helper;
+		node_data.network_epoch = POWER_SYSTEM_TOPOLOGY_EPOCH;
+	}
 	return helper;
 }
 
 
+/**
+ * Definition call: Invalidates the cached networks of all nodes.
+ * Call this whenever the link of a node or the network of a link changes.
+ */
+public func InvalidatePowerNetworkCache()
+{
+	POWER_SYSTEM_TOPOLOGY_EPOCH += 1;
+}
+
+
 /**
  * Definition call: Find out which object is the power link for a node.
  *
@@ -387,6 +933,12 @@ func CreateNetwork(bool neutral)
 	var network = CreateObject(GetPowerSystemNetwork(), 0, 0, NO_OWNER);
 	PushBack(POWER_SYSTEM_NETWORKS, network);
 	network->SetNeutral(neutral);
+	if (neutral)
+	{
+		POWER_SYSTEM_NEUTRAL_NETWORK = network;
+	}
+	// The network is removed in the next refresh if nothing is added to it.
+	RefreshPowerNetworkMembers(network);
 	return network;
 }
 
@@ -406,6 +958,32 @@ public func Init()
 	{
 		POWER_SYSTEM_NETWORKS = [];
 	}
+	if (POWER_SYSTEM_TOPOLOGY_EPOCH == nil)
+	{
+		POWER_SYSTEM_TOPOLOGY_EPOCH = 0;
+	}
+	if (GetType(POWER_SYSTEM_DIRTY_NODES) != C4V_PropList)
+	{
+		POWER_SYSTEM_DIRTY_NODES = {};
+		POWER_SYSTEM_DIRTY_NETWORKS = {};
+	}
+	if (POWER_SYSTEM_STATISTICS == nil)
+	{
+		POWER_SYSTEM_STATISTICS = NewPowerStatistics();
+	}
+	if (GetType(POWER_SYSTEM_LOADED_NETWORKS) != C4V_Array)
+	{
+		POWER_SYSTEM_LOADED_NETWORKS = [];
+	}
+	if (GetType(POWER_SYSTEM_BALANCE_QUEUE) != C4V_Array)
+	{
+		POWER_SYSTEM_BALANCE_QUEUE = [];
+		POWER_SYSTEM_BALANCE_QUEUE_HEAD = 0;
+	}
+	if (POWER_SYSTEM_BALANCE_BUDGET == nil)
+	{
+		POWER_SYSTEM_BALANCE_BUDGET = POWER_SYSTEM_BALANCE_BUDGET_DEFAULT;
+	}
 	return;
 }
 
@@ -441,3 +1019,181 @@ func DebugInfo(string message)
 		Log(message, ...);
 	}
 }
+
+
+/* -- Statistics -- */
+
+/**
+ * Definition call: Returns a new set of counters. The power system keeps one
+ * for all networks together and each network keeps its own.
+ */
+public func NewPowerStatistics()
+{
+	return {
+		frame = FrameCounter(),		// when counting started
+		balance_updates = 0,
+		nodes_visited = 0,			// producers, consumers and storages checked by balance updates
+		producer_flips = 0,
+		consumer_flips = 0,
+		display_callbacks = 0,
+		time = 0,					// milliseconds spent in balance updates, see CountPowerBalanceTime()
+		refreshes = {},				// refreshes triggered, by reason
+	};
+}
+
+
+/**
+ * Definition call: Adds to a counter of a network and to the total.
+ */
+public func CountPowerStatistic(object network, string field, int amount)
+{
+	Init();
+	POWER_SYSTEM_STATISTICS[field] += amount;
+	if (network && network.power_stats)
+	{
+		network.power_stats[field] += amount;
+	}
+}
+
+
+/**
+ * Definition call: Counts a refresh of the power balance or the network membership.
+ *
+ * @par reason what triggered the refresh, for example "storage_stop", "line_change" or "owner_change".
+ * @par network the network that is refreshed, if it is known.
+ */
+public func CountPowerRefresh(string reason, object network)
+{
+	Init();
+	POWER_SYSTEM_STATISTICS.refreshes[reason] = (POWER_SYSTEM_STATISTICS.refreshes[reason] ?? 0) + 1;
+	if (network && network.power_stats)
+	{
+		network.power_stats.refreshes[reason] = (network.power_stats.refreshes[reason] ?? 0) + 1;
+	}
+}
+
+
+/**
+ * Definition call: Returns the counters of a network, or of all networks if none is given.
+ * The counters are copied, and balance_updates_per_second is added.
+ */
+public func GetPowerStatistics(object network)
+{
+	Init();
+	var stats = POWER_SYSTEM_STATISTICS;
+	if (network)
+	{
+		stats = network.power_stats;
+	}
+	if (!stats)
+	{
+		return nil;
+	}
+	var copy = {};
+	for (var field in GetProperties(stats))
+	{
+		copy[field] = stats[field];
+	}
+	copy.refreshes = {};
+	for (var reason in GetProperties(stats.refreshes))
+	{
+		copy.refreshes[reason] = stats.refreshes[reason];
+	}
+	copy.frames = Max(1, FrameCounter() - stats.frame);
+	copy.balance_updates_per_second = stats.balance_updates * POWER_SYSTEM_FramesPerSecond / copy.frames;
+	return copy;
+}
+
+
+/**
+ * Definition call: Starts counting again, for all networks.
+ */
+public func ResetPowerStatistics()
+{
+	Init();
+	POWER_SYSTEM_STATISTICS = NewPowerStatistics();
+	for (var network in POWER_SYSTEM_NETWORKS)
+	{
+		if (network)
+		{
+			network.power_stats = NewPowerStatistics();
+		}
+	}
+}
+
+
+/**
+ * Definition call: Shows the counters on the screen of all players,
+ * with the networks that switch their nodes most often.
+ */
+public func SetPowerStatisticsOverlay(bool enable)
+{
+	var fx = GetEffect("FxPowerStatisticsOverlay", Scenario);
+	if (enable && !fx)
+	{
+		Scenario->CreateEffect(FxPowerStatisticsOverlay, 1, POWER_SYSTEM_FramesPerSecond);
+	}
+	if (!enable && fx)
+	{
+		RemoveEffect(nil, Scenario, fx);
+		CustomMessage("", nil, NO_OWNER);
+	}
+}
+
+
+local FxPowerStatisticsOverlay = new Effect {
+	Timer = func ()
+	{
+		CustomMessage(GetPowerSystem()->GetPowerStatisticsText(5), nil, NO_OWNER, 10, 60, 0xffffff, nil, nil, MSG_Left | MSG_Top);
+		return FX_OK;
+	},
+};
+
+
+/**
+ * Definition call: Describes the counters of all networks, followed by the
+ * networks with the most producer and consumer flips.
+ */
+func GetPowerStatisticsText(int max_networks)
+{
+	var total = GetPowerStatistics();
+	var text = Format("Power: %d networks, %d updates/s, %d nodes visited, %d/%d flips, %d ms", GetLength(POWER_SYSTEM_NETWORKS), total.balance_updates_per_second, total.nodes_visited, total.producer_flips, total.consumer_flips, total.time);
+	for (var reason in GetProperties(total.refreshes))
+	{
+		text = Format("%s|  refreshes by %s: %d", text, reason, total.refreshes[reason]);
+	}
+
+	var networks = [];
+	for (var network in POWER_SYSTEM_NETWORKS)
+	{
+		if (network && network.power_stats)
+		{
+			PushBack(networks, network);
+		}
+	}
+	for (var count = 0; count < max_networks && count < GetLength(networks); count++)
+	{
+		// Select the network with the most flips from the remaining ones.
+		var most = count;
+		for (var index = count + 1; index < GetLength(networks); index++)
+		{
+			if (GetPowerFlips(networks[index]) > GetPowerFlips(networks[most]))
+			{
+				most = index;
+			}
+		}
+		var network = networks[most];
+		networks[most] = networks[count];
+		networks[count] = network;
+
+		var stats = GetPowerStatistics(network);
+		text = Format("%s|%v: %d updates/s, %d nodes visited, %d/%d flips, %d ms", text, network, stats.balance_updates_per_second, stats.nodes_visited, stats.producer_flips, stats.consumer_flips, stats.time);
+	}
+	return text;
+}
+
+
+func GetPowerFlips(object network)
+{
+	return network.power_stats.producer_flips + network.power_stats.consumer_flips;
+}
@@ -0,0 +1,47 @@
+/*
+	Reports changes of the landscape to the temperature grid, so that it
+	samples the material of the changed cells again.
+ */
+
+global func DigFree(int x, int y, int radius, ...)
+{
+	var result = _inherited(x, y, radius, ...);
+	Temperature->OnLandscapeChange(x - radius, y - radius, 2 * radius, 2 * radius);
+	return result;
+}
+
+
+global func DigFreeRect(int x, int y, int wdt, int hgt, ...)
+{
+	var result = _inherited(x, y, wdt, hgt, ...);
+	Temperature->OnLandscapeChange(x, y, wdt, hgt);
+	return result;
+}
+
+
+global func ClearFreeRect(int x, int y, int wdt, int hgt, ...)
+{
+	var result = _inherited(x, y, wdt, hgt, ...);
+	Temperature->OnLandscapeChange(x, y, wdt, hgt);
+	return result;
+}
+
+
+global func BlastFree(int x, int y, int radius, ...)
+{
+	var result = _inherited(x, y, radius, ...);
+	Temperature->OnLandscapeChange(x - radius, y - radius, 2 * radius, 2 * radius);
+	return result;
+}
+
+
+global func DrawMaterialQuad(string material, int x1, int y1, int x2, int y2, int x3, int y3, int x4, int y4, ...)
+{
+	var result = _inherited(material, x1, y1, x2, y2, x3, y3, x4, y4, ...);
+	var x = Min(Min(x1, x2), Min(x3, x4));
+	var y = Min(Min(y1, y2), Min(y3, y4));
+	var wdt = Max(Max(x1, x2), Max(x3, x4)) - x;
+	var hgt = Max(Max(y1, y2), Max(y3, y4)) - y;
+	Temperature->OnLandscapeChange(x, y, wdt, hgt);
+	return result;
+}
@@ -0,0 +1,16 @@
+/* -- Power System Benchmark -- */
+
+#include Library_Map
+
+func InitializeMap(proplist map)
+{
+	Resize(640, 320);
+
+	// Flat ledges of ground, one every 10 map pixels (80 landscape pixels, see BENCHMARK_RowHeight),
+	// so that the structures of every network can stand in rows. The largest default point has room.
+	for (var y = 8; y < 320; y += 10)
+	{
+		this->Draw("Earth-earth", nil, [0, y, 640, 2]);
+	}
+	return true;
+}
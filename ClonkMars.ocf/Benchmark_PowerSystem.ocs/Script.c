@@ -0,0 +1,246 @@
+/**
+	Power System Benchmark
+	Builds N power networks with M solar panels, accumulators and material
+	units each, connected by power lines. Each N/M point runs for a fixed
+	number of frames, while the material units switch their demand. Logs the
+	percentiles of the frame times, the power system counters and the script
+	profiler totals per point, so that the points give a scaling curve.
+
+	With SetBenchmarkPoints([[N, M], ...]) other points can be run,
+	when called during runtime.
+*/
+
+
+static benchmark_points;
+
+// Frames before measuring, so that the networks are settled.
+static const BENCHMARK_WarmupFrames = 70;
+// Frames that are measured per point.
+static const BENCHMARK_Frames = 700;
+// Every this many frames one material unit per network switches its demand.
+static const BENCHMARK_ToggleInterval = 5;
+// Horizontal space for each structure, enough for a material unit.
+static const BENCHMARK_SlotWidth = 100;
+// Distance between the rows of ground, see Map.c.
+static const BENCHMARK_RowHeight = 80;
+
+func Initialize()
+{
+	benchmark_points = [[1, 4], [4, 4], [1, 16], [4, 16], [16, 4], [16, 16], [16, 32]];
+	return;
+}
+
+func InitializePlayer(int plr)
+{
+	// Set zoom to full map size.
+	SetPlayerZoomByViewRange(plr, LandscapeWidth(), nil, PLRZOOM_Direct);
+
+	// No FoW to see everything happening.
+	SetFoW(false, plr);
+
+	// The crew would only be in the way.
+	var crew = GetCrew(plr);
+	if (crew)
+		crew->RemoveObject();
+
+	// Start the benchmark for the first player.
+	if (!GetEffect("FxPowerBenchmark", Scenario))
+		Scenario->CreateEffect(FxPowerBenchmark, 100, 1, plr);
+	return;
+}
+
+
+/*-- Benchmark Control --*/
+
+// Runs the benchmark again with other N/M points.
+global func SetBenchmarkPoints(array points)
+{
+	benchmark_points = points;
+	var fx = GetEffect("FxPowerBenchmark", Scenario);
+	if (fx)
+	{
+		fx->FinishPoint(false);
+		fx.point = 0;
+		fx.results = [];
+		fx->StartPoint();
+	}
+	else
+	{
+		Scenario->CreateEffect(Scenario.FxPowerBenchmark, 100, 1, GetPlayerByIndex(0, C4PT_User));
+	}
+	return;
+}
+
+
+local FxPowerBenchmark = new Effect
+{
+	Construction = func (int plr)
+	{
+		this.plr = plr;
+		this.point = 0;
+		this.results = [];
+		this->StartPoint();
+	},
+
+	StartPoint = func ()
+	{
+		var point = benchmark_points[this.point];
+		this.networks = point[0];
+		this.nodes = point[1];
+		this.frame = 0;
+		this.frame_times = [];
+		this.last_time = nil;
+		Log("=====================================");
+		Log("Benchmark %d networks x %d panels, accumulators and material units", this.networks, this.nodes);
+		this.consumers = BuildBenchmarkNetworks(this.networks, this.nodes, this.plr);
+	},
+
+	FinishPoint = func (bool log_results)
+	{
+		if (log_results)
+		{
+			var result = GetFrameTimePercentiles(this.frame_times);
+			result.networks = this.networks;
+			result.nodes = this.nodes;
+			result.stats = GetPowerSystem()->GetPowerStatistics();
+			PushBack(this.results, result);
+			Log("Frame times: p50 %d ms, p90 %d ms, p99 %d ms, max %d ms", result.p50, result.p90, result.p99, result.max);
+			Log("Power system: %d balance updates, %d nodes visited, %d/%d flips, %d ms", result.stats.balance_updates, result.stats.nodes_visited, result.stats.producer_flips, result.stats.consumer_flips, result.stats.time);
+			Log("Script profiler totals:");
+			StopScriptProfiler();
+		}
+		RemoveAll(Find_ID(PowerLine));
+		RemoveAll(Find_Or(Find_ID(Structure_SolarPanel), Find_ID(Structure_Accumulator), Find_ID(Structure_MaterialUnit)));
+	},
+
+	Timer = func ()
+	{
+		this.frame++;
+		// Switch the demand of one material unit per network, round robin.
+		if (this.frame % BENCHMARK_ToggleInterval == 0)
+		{
+			var index = this.frame / BENCHMARK_ToggleInterval;
+			for (var network_consumers in this.consumers)
+			{
+				ToggleBenchmarkConsumer(network_consumers[index % GetLength(network_consumers)]);
+			}
+		}
+		// Start measuring after the warmup.
+		if (this.frame == BENCHMARK_WarmupFrames)
+		{
+			GetPowerSystem()->ResetPowerStatistics();
+			StartScriptProfiler();
+			this.last_time = GetTime();
+			return FX_OK;
+		}
+		if (this.last_time == nil)
+			return FX_OK;
+		var time = GetTime();
+		PushBack(this.frame_times, time - this.last_time);
+		this.last_time = time;
+		if (GetLength(this.frame_times) < BENCHMARK_Frames)
+			return FX_OK;
+
+		// Next point, or the summary after the last one.
+		this->FinishPoint(true);
+		this.point++;
+		if (this.point < GetLength(benchmark_points))
+		{
+			this->StartPoint();
+			return FX_OK;
+		}
+		LogBenchmarkResults(this.results);
+		return FX_Execute_Kill;
+	}
+};
+
+
+/*-- Helper Functions --*/
+
+// Creates the networks and returns the material units of each network. The structures stand
+// in rows on the ground ledges of the map. The rows alternate their direction, so that the
+// power line from the end of one row to the start of the next one stays short.
+global func BuildBenchmarkNetworks(int network_count, int node_count, int plr)
+{
+	var all_consumers = [];
+	var slots_per_row = (LandscapeWidth() - 40) / BENCHMARK_SlotWidth;
+	var row_count = LandscapeHeight() / BENCHMARK_RowHeight;
+	if (network_count * node_count * 3 > slots_per_row * row_count)
+		Log("WARNING: The map has room for %d structures only, some structures overlap.", slots_per_row * row_count);
+	var slot = 0;
+	for (var network = 0; network < network_count; network++)
+	{
+		var previous = nil;
+		var consumers = [];
+		for (var node = 0; node < node_count; node++)
+		{
+			for (var type in [Structure_SolarPanel, Structure_Accumulator, Structure_MaterialUnit])
+			{
+				var row = (slot / slots_per_row) % row_count;
+				var column = slot % slots_per_row;
+				if (row % 2 == 1)
+					column = slots_per_row - 1 - column;
+				var x = 20 + BENCHMARK_SlotWidth / 2 + column * BENCHMARK_SlotWidth;
+				var ground_y = (row + 1) * BENCHMARK_RowHeight - 16;
+				var structure = CreateObjectAbove(type, x, ground_y, plr);
+				slot++;
+				// The structures of a network form a chain of power lines.
+				if (previous)
+				{
+					var line = CreateObject(PowerLine, 0, 0, NO_OWNER);
+					line->SetActionTargets(previous, structure);
+				}
+				previous = structure;
+				if (type == Structure_MaterialUnit)
+					PushBack(consumers, structure);
+			}
+		}
+		PushBack(all_consumers, consumers);
+	}
+	// Group all lines into their networks at once, instead of after each line.
+	PowerLine->RefreshAllLineNetworks();
+	return all_consumers;
+}
+
+// Switches a material unit between needing power and not needing it. The state is kept on the
+// material unit, because unregistering the request does not reset its power consumption.
+global func ToggleBenchmarkConsumer(object consumer)
+{
+	if (!consumer)
+		return;
+	if (consumer.benchmark_needs_power)
+		consumer->UnregisterPowerRequest();
+	else
+		consumer->RegisterPowerRequest(consumer->PowerNeed());
+	consumer.benchmark_needs_power = !consumer.benchmark_needs_power;
+	return;
+}
+
+// Returns the percentiles of the measured frame times, in milliseconds.
+global func GetFrameTimePercentiles(array frame_times)
+{
+	var sorted = frame_times[:];
+	SortArray(sorted);
+	var count = GetLength(sorted);
+	if (count == 0)
+		return {p50 = 0, p90 = 0, p99 = 0, max = 0};
+	return {
+		p50 = sorted[(count - 1) * 50 / 100],
+		p90 = sorted[(count - 1) * 90 / 100],
+		p99 = sorted[(count - 1) * 99 / 100],
+		max = sorted[count - 1]
+	};
+}
+
+// Logs one line per point, so that the scaling curve can be copied from the log.
+global func LogBenchmarkResults(array results)
+{
+	Log("=====================================");
+	Log("networks, nodes, p50 ms, p90 ms, p99 ms, max ms, balance updates, nodes visited, flips, power ms");
+	for (var result in results)
+	{
+		Log("%d, %d, %d, %d, %d, %d, %d, %d, %d, %d", result.networks, result.nodes, result.p50, result.p90, result.p99, result.max, result.stats.balance_updates, result.stats.nodes_visited, result.stats.producer_flips + result.stats.consumer_flips, result.stats.time);
+	}
+	Log("=====================================");
+	return;
+}
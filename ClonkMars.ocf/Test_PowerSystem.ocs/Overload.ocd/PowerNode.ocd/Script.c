@@ -0,0 +1,47 @@
+/**
+	Power Node
+	A structure for the power system tests, which produces and consumes
+	exactly the amounts that a test sets.
+*/
+
+#include Library_Structure
+#include Library_PowerSystem_Consumer
+#include Library_PowerSystem_Producer
+
+local is_test_steady = true;
+
+// The node produces all the time, unless the test makes it an on-demand producer.
+public func IsSteadyPowerProducer() { return is_test_steady; }
+
+public func SetTestSteady(bool steady)
+{
+	is_test_steady = steady;
+	return;
+}
+
+// Sets the power that this node needs, nothing if the amount is 0.
+// The request is registered again, like structures do when their demand changes.
+public func SetTestDemand(int amount, int priority)
+{
+	UnregisterPowerRequest();
+	if (priority != nil)
+		SetConsumerPriority(priority);
+	if (amount > 0)
+		RegisterPowerRequest(amount);
+	return;
+}
+
+// Sets the power that this node produces, nothing if the amount is 0.
+public func SetTestProduction(int amount)
+{
+	if (amount > 0)
+		RegisterPowerProduction(amount);
+	else
+		UnregisterPowerProduction();
+	return;
+}
+
+
+/*-- Properties --*/
+
+local Name = "Power Node";
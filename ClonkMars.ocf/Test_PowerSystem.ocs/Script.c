@@ -1264,9 +1264,1030 @@ global func Test22_OnFinished()
 	return;
 }
 
+static POWER_SYSTEM_Test23_Frame;
+
+// Test the distribution of excess power to a large amount of power storages.
+global func Test23_OnStart(int plr)
+{
+	POWER_SYSTEM_Test23_Frame = FrameCounter();
+
+	// Power source: wind generators.
+	SetWindFixed(100);
+	CreateObjectAbove(WindGenerator, 440, 104, plr);
+	CreateObjectAbove(WindGenerator, 460, 104, plr);
+	CreateObjectAbove(WindGenerator, 480, 104, plr);
+	CreateObjectAbove(WindGenerator, 500, 104, plr);
+
+	// Power storage: accumulators with different storage powers and charge levels.
+	for (var i = 0; i < 36; i++)
+	{
+		var accumulator = CreateObjectAbove(Structure_Accumulator, 20 + (i % 12) * 25, 160 + (i / 12) * 64, plr);
+		accumulator->SetStoragePower(5 + i % 7);
+		accumulator->SetStoredPower(accumulator->GetStorageCapacity() * (i % 9) / 8);
+	}
+
+	// Log what the test is about.
+	Log("Excess power is distributed equally among a lot of accumulators, the same as when handing out single units.");
+	return true;
+}
+
+global func Test23_Completed()
+{
+	// Let the network settle first.
+	if (FrameCounter() - POWER_SYSTEM_Test23_Frame < 36)
+		return false;
+
+	var lower_bounds = [];
+	var upper_bounds = [];
+	var total_span = 0;
+	for (var accumulator in FindObjects(Find_ID(Structure_Accumulator)))
+	{
+		var lower = -accumulator->GetPowerProduction();
+		var upper = Min(accumulator->GetStoragePower(), accumulator->GetStorageRemaining());
+		PushBack(lower_bounds, lower);
+		PushBack(upper_bounds, upper);
+		total_span += Max(0, upper - lower);
+	}
+
+	for (var excess = -5; excess <= total_span + 5; excess++)
+	{
+		var expected = DistributeExcessPowerUnitByUnit(excess, lower_bounds, upper_bounds);
+		var actual = Library_PowerSystem_Network->DistributeExcessPower(excess, lower_bounds, upper_bounds);
+		for (var i = 0; i < GetLength(expected); i++)
+		{
+			if (expected[i] != actual[i])
+			{
+				Log("Excess %d: storage %d gets %d, but should get %d", excess, i, actual[i], expected[i]);
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+global func Test23_OnFinished()
+{
+	RemoveAll(Find_Or(Find_ID(WindGenerator), Find_ID(Structure_Accumulator)));
+	return;
+}
+
+
+// The network keeps the stored power as a running total and records its history.
+static POWER_SYSTEM_Test24_Frame;
+
+global func Test24_OnStart(int plr)
+{
+	POWER_SYSTEM_Test24_Frame = FrameCounter();
+
+	// Power source: wind generators.
+	SetWindFixed(100);
+	CreateObjectAbove(WindGenerator, 440, 104, plr);
+	CreateObjectAbove(WindGenerator, 460, 104, plr);
+
+	// Power storage: accumulators that are charged and some that are full.
+	for (var i = 0; i < 6; i++)
+	{
+		var accumulator = CreateObjectAbove(Structure_Accumulator, 20 + i * 25, 160, plr);
+		accumulator->SetStoredPower(accumulator->GetStorageCapacity() * i / 5);
+	}
+	// Remember the stored power of every frame, to compare it with the history.
+	AddEffect("IntRecordStoredPower", nil, 100, 1);
+
+	// Log what the test is about.
+	Log("The stored power of a network is the sum of its storages, and the network records a history of it.");
+	return true;
+}
+
+global func Test24_Completed()
+{
+	// Wait for a few history records.
+	if (FrameCounter() - POWER_SYSTEM_Test24_Frame < 3 * POWER_SYSTEM_HISTORY_Interval)
+		return false;
+
+	var network;
+	var stored_power = 0, capacity = 0;
+	for (var accumulator in FindObjects(Find_ID(Structure_Accumulator)))
+	{
+		network = GetPowerSystem()->GetPowerNetwork(accumulator);
+		stored_power += accumulator->GetStoredPower();
+		capacity += accumulator->GetStorageCapacity();
+	}
+	if (network->GetStoredPower() != stored_power || network->GetStoredPowerCapacity() != capacity)
+	{
+		Log("Network stores %d of %d, but the storages hold %d of %d", network->GetStoredPower(), network->GetStoredPowerCapacity(), stored_power, capacity);
+		return false;
+	}
+	// The latest value of the history is what the storages held in the frame that it was recorded.
+	var history = network->GetPowerHistory("stored");
+	var recorded = GetEffect("IntRecordStoredPower").stored_power[Format("%d", network->GetPowerHistoryFrame())];
+	if (GetLength(history) < 2 || recorded == nil || history[GetLength(history) - 1] != recorded)
+	{
+		Log("Stored power history is %v, the storages held %v in frame %d", history, recorded, network->GetPowerHistoryFrame());
+		return false;
+	}
+	return true;
+}
+
+global func Test24_OnFinished()
+{
+	RemoveEffect("IntRecordStoredPower");
+	RemoveAll(Find_Or(Find_ID(WindGenerator), Find_ID(Structure_Accumulator)));
+	return;
+}
+
+
+// Removing a structure that connects two groups of power lines splits their network.
+static POWER_SYSTEM_Test25_Frame;
+static POWER_SYSTEM_Test25_Structures;
+
+global func Test25_OnStart(int plr)
+{
+	POWER_SYSTEM_Test25_Frame = FrameCounter();
+
+	// Power storage: a chain of accumulators, the one in the middle connects both sides.
+	POWER_SYSTEM_Test25_Structures = [];
+	for (var i = 0; i < 5; i++)
+	{
+		PushBack(POWER_SYSTEM_Test25_Structures, CreateObjectAbove(Structure_Accumulator, 20 + i * 40, 160, plr));
+	}
+	for (var i = 0; i < 4; i++)
+	{
+		var line = CreateObject(PowerLine, 0, 0, NO_OWNER);
+		line->SetActionTargets(POWER_SYSTEM_Test25_Structures[i], POWER_SYSTEM_Test25_Structures[i + 1]);
+	}
+	PowerLine->RefreshAllLineNetworks();
+
+	// Log what the test is about.
+	Log("A structure that connects two sides of a power line network is removed, the sides get separate networks.");
+	return true;
+}
+
+global func Test25_Completed()
+{
+	var structures = POWER_SYSTEM_Test25_Structures;
+	var hub = structures[2];
+
+	// Let the network settle, then remove the structure in the middle.
+	if (FrameCounter() - POWER_SYSTEM_Test25_Frame < 10)
+		return false;
+	if (hub)
+	{
+		if (GetPowerSystem()->GetPowerNetwork(structures[0]) != GetPowerSystem()->GetPowerNetwork(structures[4]))
+		{
+			Log("The accumulators are not in the same network before the removal");
+			return false;
+		}
+		hub->RemoveObject();
+		return false;
+	}
+	if (FrameCounter() - POWER_SYSTEM_Test25_Frame < 20)
+		return false;
+
+	var left = GetPowerSystem()->GetPowerNetwork(structures[0]);
+	var right = GetPowerSystem()->GetPowerNetwork(structures[4]);
+	if (left == right || left != GetPowerSystem()->GetPowerNetwork(structures[1]) || right != GetPowerSystem()->GetPowerNetwork(structures[3]))
+	{
+		Log("Left side is in %v and %v, right side is in %v and %v", left, GetPowerSystem()->GetPowerNetwork(structures[1]), GetPowerSystem()->GetPowerNetwork(structures[3]), right);
+		return false;
+	}
+	return true;
+}
+
+global func Test25_OnFinished()
+{
+	RemoveAll(Find_ID(PowerLine));
+	RemoveAll(Find_ID(Structure_Accumulator));
+	return;
+}
+
+
+// A network restores its saved topology: the settings, its nodes and the charge of its storages.
+static POWER_SYSTEM_Test26_Frame;
+static POWER_SYSTEM_Test26_Structures;
+static POWER_SYSTEM_Test26_Network;
+
+global func Test26_OnStart(int plr)
+{
+	POWER_SYSTEM_Test26_Frame = FrameCounter();
+	POWER_SYSTEM_Test26_Network = nil;
+
+	// Power storage: a chain of accumulators with different charge levels.
+	POWER_SYSTEM_Test26_Structures = [];
+	for (var i = 0; i < 3; i++)
+	{
+		var accumulator = CreateObjectAbove(Structure_Accumulator, 20 + i * 40, 160, plr);
+		accumulator->SetStoredPower(accumulator->GetStorageCapacity() * (i + 1) / 4);
+		PushBack(POWER_SYSTEM_Test26_Structures, accumulator);
+	}
+	for (var i = 0; i < 2; i++)
+	{
+		var line = CreateObject(PowerLine, 0, 0, NO_OWNER);
+		line->SetActionTargets(POWER_SYSTEM_Test26_Structures[i], POWER_SYSTEM_Test26_Structures[i + 1]);
+	}
+	PowerLine->RefreshAllLineNetworks();
+
+	// Log what the test is about.
+	Log("A network is saved with plain calls and restored from them, including its settings and the charge of its storages.");
+	return true;
+}
+
+global func Test26_Completed()
+{
+	var structures = POWER_SYSTEM_Test26_Structures;
+
+	// Let the network settle, then save it and replay the saved calls.
+	if (FrameCounter() - POWER_SYSTEM_Test26_Frame < 10)
+		return false;
+	if (!POWER_SYSTEM_Test26_Network)
+	{
+		var network = GetPowerSystem()->GetPowerNetwork(structures[0]);
+		POWER_SYSTEM_Test26_Network = network;
+		network->SetPowerHysteresis(7);
+		network->SetPowerMinimumDwellTime(11);
+
+		var props = new TestScenarioSaveProps { calls = [] };
+		network->SavePowerTopology(props);
+
+		// Forget the state that is saved, like a freshly loaded network.
+		network->SetPowerHysteresis(0);
+		network->SetPowerMinimumDwellTime(0);
+		for (var accumulator in structures)
+			accumulator->SetStoredPower(0);
+
+		props->ReplayCalls();
+		return false;
+	}
+	if (FrameCounter() - POWER_SYSTEM_Test26_Frame < 20)
+		return false;
+
+	var network = POWER_SYSTEM_Test26_Network;
+	if (network->GetPowerHysteresis() != 7 || network->GetPowerMinimumDwellTime() != 11)
+	{
+		Log("Network has hysteresis %d and dwell time %d, but should have 7 and 11", network->GetPowerHysteresis(), network->GetPowerMinimumDwellTime());
+		return false;
+	}
+	for (var i = 0; i < GetLength(structures); i++)
+	{
+		var accumulator = structures[i];
+		var expected = accumulator->GetStorageCapacity() * (i + 1) / 4;
+		if (GetPowerSystem()->GetPowerNetwork(accumulator) != network || accumulator->GetStoredPower() != expected)
+		{
+			Log("%v is in %v and stores %d, but should be in %v and store %d", accumulator, GetPowerSystem()->GetPowerNetwork(accumulator), accumulator->GetStoredPower(), network, expected);
+			return false;
+		}
+	}
+	return true;
+}
+
+global func Test26_OnFinished()
+{
+	RemoveAll(Find_ID(PowerLine));
+	RemoveAll(Find_ID(Structure_Accumulator));
+	return;
+}
+
+
+// A saved network takes over its lines, even if they got another network while loading.
+static POWER_SYSTEM_Test27_Frame;
+static POWER_SYSTEM_Test27_Structures;
+static POWER_SYSTEM_Test27_Network;
+static POWER_SYSTEM_Test27_LoadedNetwork;
+
+global func Test27_OnStart(int plr)
+{
+	POWER_SYSTEM_Test27_Frame = FrameCounter();
+	POWER_SYSTEM_Test27_Network = nil;
+	POWER_SYSTEM_Test27_LoadedNetwork = nil;
+
+	// Power storage: a chain of accumulators.
+	POWER_SYSTEM_Test27_Structures = [];
+	for (var i = 0; i < 3; i++)
+	{
+		PushBack(POWER_SYSTEM_Test27_Structures, CreateObjectAbove(Structure_Accumulator, 20 + i * 40, 160, plr));
+	}
+	for (var i = 0; i < 2; i++)
+	{
+		var line = CreateObject(PowerLine, 0, 0, NO_OWNER);
+		line->SetActionTargets(POWER_SYSTEM_Test27_Structures[i], POWER_SYSTEM_Test27_Structures[i + 1]);
+	}
+	PowerLine->RefreshAllLineNetworks();
+
+	// Log what the test is about.
+	Log("A saved network is restored after its lines got another network while loading, the saved network takes them over.");
+	return true;
+}
+
+global func Test27_Completed()
+{
+	var structures = POWER_SYSTEM_Test27_Structures;
+
+	// Let the network settle, then save it and replay the saved calls.
+	if (FrameCounter() - POWER_SYSTEM_Test27_Frame < 10)
+		return false;
+	if (!POWER_SYSTEM_Test27_Network)
+	{
+		var network = GetPowerSystem()->GetPowerNetwork(structures[0]);
+		POWER_SYSTEM_Test27_Network = network;
+		network->SetPowerHysteresis(5);
+
+		var props = new TestScenarioSaveProps { calls = [] };
+		network->SavePowerTopology(props);
+
+		// The helpers of the lines are not saved: clear them, then let a node ask
+		// for its network, like a node does while it is loaded.
+		for (var line in FindObjects(Find_ID(PowerLine)))
+			line->SetPowerHelper(nil);
+		POWER_SYSTEM_Test27_LoadedNetwork = GetPowerSystem()->GetPowerNetwork(structures[0]);
+		for (var accumulator in structures)
+			GetPowerSystem()->TransferPowerLink(accumulator);
+
+		props->ReplayCalls();
+		return false;
+	}
+	if (FrameCounter() - POWER_SYSTEM_Test27_Frame < 20)
+		return false;
+
+	var network = POWER_SYSTEM_Test27_Network;
+	if (POWER_SYSTEM_Test27_LoadedNetwork == network)
+	{
+		Log("The lines did not get another network while loading");
+		return false;
+	}
+	if (network->GetPowerHysteresis() != 5)
+	{
+		Log("Network has hysteresis %d, but should have 5", network->GetPowerHysteresis());
+		return false;
+	}
+	for (var line in FindObjects(Find_ID(PowerLine)))
+	{
+		if (line->GetPowerHelper() != network)
+		{
+			Log("%v has helper %v, but should have %v", line, line->GetPowerHelper(), network);
+			return false;
+		}
+	}
+	for (var accumulator in structures)
+	{
+		if (GetPowerSystem()->GetPowerNetwork(accumulator) != network || !network->ContainsPowerLink(accumulator))
+		{
+			Log("%v is in %v, but should be in %v", accumulator, GetPowerSystem()->GetPowerNetwork(accumulator), network);
+			return false;
+		}
+	}
+	if (POWER_SYSTEM_Test27_LoadedNetwork)
+	{
+		Log("The network from loading %v was not removed", POWER_SYSTEM_Test27_LoadedNetwork);
+		return false;
+	}
+	return true;
+}
+
+global func Test27_OnFinished()
+{
+	RemoveAll(Find_ID(PowerLine));
+	RemoveAll(Find_ID(Structure_Accumulator));
+	return;
+}
+
+
+// The cached network of a node is resolved again after owner, flag and line changes.
+static POWER_SYSTEM_Test28_Frame;
+static POWER_SYSTEM_Test28_Structures;
+static POWER_SYSTEM_Test28_Epoch;
+
+global func Test28_OnStart(int plr)
+{
+	POWER_SYSTEM_Test28_Frame = FrameCounter();
+	POWER_SYSTEM_Test28_Epoch = nil;
+
+	// Power storage: two pairs of accumulators, each pair connected by a power line.
+	POWER_SYSTEM_Test28_Structures = [];
+	for (var i = 0; i < 4; i++)
+	{
+		PushBack(POWER_SYSTEM_Test28_Structures, CreateObjectAbove(Structure_Accumulator, 20 + i * 40, 160, plr));
+	}
+	for (var i = 0; i < 4; i += 2)
+	{
+		var line = CreateObject(PowerLine, 0, 0, NO_OWNER);
+		line->SetActionTargets(POWER_SYSTEM_Test28_Structures[i], POWER_SYSTEM_Test28_Structures[i + 1]);
+	}
+	PowerLine->RefreshAllLineNetworks();
+
+	// Log what the test is about.
+	Log("The network of a node is cached, and resolved again right after an owner, flag or line change.");
+	return true;
+}
+
+global func Test28_Completed()
+{
+	var structures = POWER_SYSTEM_Test28_Structures;
+
+	// Let the networks settle first.
+	if (FrameCounter() - POWER_SYSTEM_Test28_Frame < 10)
+		return false;
+
+	// The network is cached for the current epoch, then the owner changes.
+	if (POWER_SYSTEM_Test28_Epoch == nil)
+	{
+		var network = GetPowerSystem()->GetPowerNetwork(structures[0]);
+		if (structures[0].lib_power_system.network != network || structures[0].lib_power_system.network_epoch != POWER_SYSTEM_TOPOLOGY_EPOCH)
+		{
+			Log("Network %v is not cached for epoch %d", network, POWER_SYSTEM_TOPOLOGY_EPOCH);
+			return false;
+		}
+		if (GetPowerSystem()->GetPowerNetwork(structures[2]) == network)
+		{
+			Log("The pairs of accumulators should be in different networks");
+			return false;
+		}
+		POWER_SYSTEM_Test28_Epoch = POWER_SYSTEM_TOPOLOGY_EPOCH;
+		structures[0]->SetOwner(NO_OWNER);
+		return false;
+	}
+	if (POWER_SYSTEM_TOPOLOGY_EPOCH == POWER_SYSTEM_Test28_Epoch)
+	{
+		Log("The epoch did not change after an owner change");
+		return false;
+	}
+
+	// Flag change: the link gets another helper, like the lines of a flag do when its links change.
+	var line = PowerLine->GetAttachedLines(structures[0])[0];
+	var other_network = GetPowerSystem()->CreateNetwork();
+	line->SetPowerHelper(other_network, true);
+	if (GetPowerSystem()->GetPowerNetwork(structures[0]) != other_network || GetPowerSystem()->GetPowerNetwork(structures[1]) != other_network)
+	{
+		Log("After the helper changed, the accumulators are in %v and %v instead of %v", GetPowerSystem()->GetPowerNetwork(structures[0]), GetPowerSystem()->GetPowerNetwork(structures[1]), other_network);
+		return false;
+	}
+
+	// Line change: connecting both pairs puts all accumulators into one network right away.
+	var connection = CreateObject(PowerLine, 0, 0, NO_OWNER);
+	connection->SetActionTargets(structures[1], structures[2]);
+	PowerLine->RefreshAllLineNetworks();
+	var network = GetPowerSystem()->GetPowerNetwork(structures[0]);
+	for (var accumulator in structures)
+	{
+		if (GetPowerSystem()->GetPowerNetwork(accumulator) != network)
+		{
+			Log("After connecting the pairs, %v is in %v instead of %v", accumulator, GetPowerSystem()->GetPowerNetwork(accumulator), network);
+			return false;
+		}
+	}
+	return true;
+}
+
+global func Test28_OnFinished()
+{
+	RemoveAll(Find_ID(PowerLine));
+	RemoveAll(Find_ID(Structure_Accumulator));
+	return;
+}
+
+
+// The hysteresis band and the minimum dwell time keep an on-demand producer from flapping.
+static POWER_SYSTEM_Test29_Frame;
+static POWER_SYSTEM_Test29_Step;
+static POWER_SYSTEM_Test29_Nodes;
+static POWER_SYSTEM_Test29_ToggleCount;
+
+global func Test29_OnStart(int plr)
+{
+	POWER_SYSTEM_Test29_Frame = FrameCounter();
+	POWER_SYSTEM_Test29_Step = 0;
+
+	// Power nodes: a steady producer, an on-demand producer and a consumer.
+	POWER_SYSTEM_Test29_Nodes = CreatePowerNodes(3, plr);
+	var steady = POWER_SYSTEM_Test29_Nodes[0];
+	var on_demand = POWER_SYSTEM_Test29_Nodes[1];
+	var consumer = POWER_SYSTEM_Test29_Nodes[2];
+	steady->SetProducerPriority(100);
+	steady->SetTestProduction(30);
+	on_demand->SetTestSteady(false);
+	on_demand->SetTestProduction(20);
+	GetPowerSystem()->GetPowerNetwork(consumer)->SetPowerHysteresis(10);
+	consumer->SetTestDemand(45);
+
+	// Log what the test is about.
+	Log("An on-demand producer is switched off only outside of the hysteresis band, and not before the dwell time has passed.");
+	return true;
+}
+
+global func Test29_Completed()
+{
+	var on_demand = POWER_SYSTEM_Test29_Nodes[1];
+	var consumer = POWER_SYSTEM_Test29_Nodes[2];
+	var network = GetPowerSystem()->GetPowerNetwork(consumer);
+
+	// Every step waits until the network has settled, the dwell time is waited out as well.
+	var wait = 10;
+	if (POWER_SYSTEM_Test29_Step == 4)
+		wait = 70;
+	if (FrameCounter() - POWER_SYSTEM_Test29_Frame < wait)
+		return false;
+
+	// The demand exceeds the steady production, the on-demand producer helps out.
+	if (POWER_SYSTEM_Test29_Step == 0)
+	{
+		if (!on_demand->IsPowerProductionActive() || !consumer->HasEnoughPower())
+		{
+			Log("The on-demand producer is not active (%v), or the consumer has no power (%v)", on_demand->IsPowerProductionActive(), consumer->HasEnoughPower());
+			return false;
+		}
+		consumer->SetTestDemand(28);
+	}
+	// The steady producer covers the demand, but not the hysteresis band on top.
+	else if (POWER_SYSTEM_Test29_Step == 1)
+	{
+		if (!on_demand->IsPowerProductionActive())
+		{
+			Log("The on-demand producer was switched off within the hysteresis band");
+			return false;
+		}
+		consumer->SetTestDemand(15);
+	}
+	// Now the steady producer covers the band, too. The dwell time starts with the switch.
+	else if (POWER_SYSTEM_Test29_Step == 2)
+	{
+		if (on_demand->IsPowerProductionActive())
+		{
+			Log("The on-demand producer was not switched off outside of the hysteresis band");
+			return false;
+		}
+		network->SetPowerHysteresis(0);
+		network->SetPowerMinimumDwellTime(60);
+		consumer->SetTestDemand(45);
+	}
+	// The producer must not be switched on again before the dwell time has passed.
+	else if (POWER_SYSTEM_Test29_Step == 3)
+	{
+		if (on_demand->IsPowerProductionActive() || consumer->HasEnoughPower())
+		{
+			Log("The on-demand producer was switched on again within the dwell time");
+			return false;
+		}
+	}
+	// Once the dwell time has passed, the producer is switched on and stays on for the dwell time.
+	else if (POWER_SYSTEM_Test29_Step == 4)
+	{
+		if (!on_demand->IsPowerProductionActive() || !consumer->HasEnoughPower())
+		{
+			Log("The on-demand producer is not active (%v) after the dwell time, or the consumer has no power (%v)", on_demand->IsPowerProductionActive(), consumer->HasEnoughPower());
+			return false;
+		}
+		POWER_SYSTEM_Test29_ToggleCount = network->GetPowerToggleCount();
+		consumer->SetTestDemand(15);
+	}
+	else
+	{
+		if (!on_demand->IsPowerProductionActive() || network->GetPowerToggleCount() != POWER_SYSTEM_Test29_ToggleCount)
+		{
+			Log("The on-demand producer was switched off within the dwell time, toggle count is %d instead of %d", network->GetPowerToggleCount(), POWER_SYSTEM_Test29_ToggleCount);
+			return false;
+		}
+		return true;
+	}
+	POWER_SYSTEM_Test29_Step++;
+	POWER_SYSTEM_Test29_Frame = FrameCounter();
+	return false;
+}
+
+global func Test29_OnFinished()
+{
+	RemoveAll(Find_ID(PowerLine));
+	RemoveAll(Find_ID(Test_PowerNode));
+	return;
+}
+
+
+// Supplying the consumers by the prefix-sum cut gives the same result as walking all of them.
+static POWER_SYSTEM_Test30_Frame;
+static POWER_SYSTEM_Test30_Step;
+static POWER_SYSTEM_Test30_Nodes;
+static const POWER_SYSTEM_Test30_Production = [100, 37, 64, 12, 150, 53];
+
+global func Test30_OnStart(int plr)
+{
+	POWER_SYSTEM_Test30_Frame = FrameCounter();
+	POWER_SYSTEM_Test30_Step = 0;
+
+	// Power nodes: a steady producer and consumers with different demands and priorities.
+	POWER_SYSTEM_Test30_Nodes = CreatePowerNodes(13, plr);
+	POWER_SYSTEM_Test30_Nodes[0]->SetTestProduction(POWER_SYSTEM_Test30_Production[0]);
+	for (var i = 1; i < GetLength(POWER_SYSTEM_Test30_Nodes); i++)
+	{
+		POWER_SYSTEM_Test30_Nodes[i]->SetTestDemand(5 + (i * 7) % 23, (i * 37) % 4 * 25);
+	}
+
+	// Log what the test is about.
+	Log("Consumers are supplied by a cut through the prefix sums of their demands, the same ones as by walking all consumers.");
+	return true;
+}
+
+global func Test30_Completed()
+{
+	var producer = POWER_SYSTEM_Test30_Nodes[0];
+
+	if (FrameCounter() - POWER_SYSTEM_Test30_Frame < 10)
+		return false;
+
+	// The consumers that a walk in priority order would supply.
+	var network = GetPowerSystem()->GetPowerNetwork(producer);
+	var power_level = POWER_SYSTEM_Test30_Production[POWER_SYSTEM_Test30_Step];
+	for (var consumer in network->GetPowerConsumers())
+	{
+		var demand = consumer->GetPowerConsumption();
+		var supplied = demand <= power_level;
+		if (supplied)
+			power_level -= demand;
+		if (consumer->HasEnoughPower() != supplied)
+		{
+			Log("With %d units produced, %v needs %d units and has enough power: %v, but should be %v", POWER_SYSTEM_Test30_Production[POWER_SYSTEM_Test30_Step], consumer, demand, consumer->HasEnoughPower(), supplied);
+			return false;
+		}
+	}
+
+	// Change only the production, so that the next updates move the cut.
+	POWER_SYSTEM_Test30_Step++;
+	if (POWER_SYSTEM_Test30_Step >= GetLength(POWER_SYSTEM_Test30_Production))
+		return true;
+	producer->SetTestProduction(POWER_SYSTEM_Test30_Production[POWER_SYSTEM_Test30_Step]);
+	POWER_SYSTEM_Test30_Frame = FrameCounter();
+	return false;
+}
+
+global func Test30_OnFinished()
+{
+	RemoveAll(Find_ID(PowerLine));
+	RemoveAll(Find_ID(Test_PowerNode));
+	return;
+}
+
+
+// A network is split and joined again, the nodes are moved in bulk and each network checks its balance once.
+static POWER_SYSTEM_Test31_Frame;
+static POWER_SYSTEM_Test31_Step;
+static POWER_SYSTEM_Test31_Nodes;
+static POWER_SYSTEM_Test31_Networks;
+
+global func Test31_OnStart(int plr)
+{
+	POWER_SYSTEM_Test31_Frame = FrameCounter();
+	POWER_SYSTEM_Test31_Step = 0;
+	POWER_SYSTEM_Test31_Networks = nil;
+
+	// Power nodes: a chain with a producer and two consumers on either side.
+	POWER_SYSTEM_Test31_Nodes = CreatePowerNodes(6, plr);
+	POWER_SYSTEM_Test31_Nodes[0]->SetTestProduction(40);
+	POWER_SYSTEM_Test31_Nodes[1]->SetTestDemand(10);
+	POWER_SYSTEM_Test31_Nodes[2]->SetTestDemand(10);
+	POWER_SYSTEM_Test31_Nodes[3]->SetTestDemand(15);
+	POWER_SYSTEM_Test31_Nodes[4]->SetTestDemand(15);
+	POWER_SYSTEM_Test31_Nodes[5]->SetTestProduction(20);
+
+	// Log what the test is about.
+	Log("A network is split by removing a line and joined again by a new line, the nodes are moved in bulk.");
+	return true;
+}
+
+global func Test31_Completed()
+{
+	var nodes = POWER_SYSTEM_Test31_Nodes;
+
+	if (FrameCounter() - POWER_SYSTEM_Test31_Frame < 10)
+		return false;
+
+	// Split the chain in the middle.
+	if (POWER_SYSTEM_Test31_Step == 0)
+	{
+		if (!CheckPowerNodeNetwork(nodes, 60, 50))
+			return false;
+		GetPowerSystem()->ResetPowerStatistics();
+		for (var line in PowerLine->GetAttachedLines(nodes[2]))
+		{
+			if (line->IsConnectedTo(nodes[3]))
+				line->RemoveObject();
+		}
+	}
+	// Each side has its own network now, then join them again.
+	else if (POWER_SYSTEM_Test31_Step == 1)
+	{
+		var left = CheckPowerNodeNetwork(nodes[:3], 40, 20);
+		var right = CheckPowerNodeNetwork(nodes[3:], 20, 30);
+		if (!left || !right)
+			return false;
+		if (left == right)
+		{
+			Log("Both sides are in network %v after the split", left);
+			return false;
+		}
+		for (var network in [left, right])
+		{
+			var stats = GetPowerSystem()->GetPowerStatistics(network);
+			if (stats.balance_updates != 1)
+			{
+				Log("Network %v checked its balance %d times after the split, instead of once", network, stats.balance_updates);
+				return false;
+			}
+		}
+		POWER_SYSTEM_Test31_Networks = [left, right];
+		GetPowerSystem()->ResetPowerStatistics();
+		var line = CreateObject(PowerLine, 0, 0, NO_OWNER);
+		line->SetActionTargets(nodes[2], nodes[3]);
+		PowerLine->RefreshAllLineNetworks();
+	}
+	// One network takes over the nodes of the other, which is removed.
+	else
+	{
+		var network = CheckPowerNodeNetwork(nodes, 60, 50);
+		if (!network)
+			return false;
+		var stats = GetPowerSystem()->GetPowerStatistics(network);
+		if (stats.balance_updates != 1)
+		{
+			Log("Network %v checked its balance %d times after the join, instead of once", network, stats.balance_updates);
+			return false;
+		}
+		var other = POWER_SYSTEM_Test31_Networks[0];
+		if (other == network)
+			other = POWER_SYSTEM_Test31_Networks[1];
+		if (other)
+		{
+			Log("Network %v was not removed after the join", other);
+			return false;
+		}
+		return true;
+	}
+	POWER_SYSTEM_Test31_Step++;
+	POWER_SYSTEM_Test31_Frame = FrameCounter();
+	return false;
+}
+
+global func Test31_OnFinished()
+{
+	RemoveAll(Find_ID(PowerLine));
+	RemoveAll(Find_ID(Test_PowerNode));
+	return;
+}
+
+
+// The callbacks of a balance update that do not fit into the budget are done in the next frames.
+static POWER_SYSTEM_Test32_Frame;
+static POWER_SYSTEM_Test32_Step;
+static POWER_SYSTEM_Test32_Nodes;
+
+global func Test32_OnStart(int plr)
+{
+	POWER_SYSTEM_Test32_Frame = FrameCounter();
+	POWER_SYSTEM_Test32_Step = 0;
+
+	// Power nodes: a steady producer that supplies many consumers.
+	POWER_SYSTEM_Test32_Nodes = CreatePowerNodes(21, plr);
+	POWER_SYSTEM_Test32_Nodes[0]->SetTestProduction(100);
+	for (var i = 1; i < GetLength(POWER_SYSTEM_Test32_Nodes); i++)
+	{
+		POWER_SYSTEM_Test32_Nodes[i]->SetTestDemand(5);
+	}
+
+	// Log what the test is about.
+	Log("A balance update switches more consumers than the budget allows, the remaining callbacks are done in the next frames.");
+	return true;
+}
+
+global func Test32_Completed()
+{
+	var nodes = POWER_SYSTEM_Test32_Nodes;
+	var network = GetPowerSystem()->GetPowerNetwork(nodes[0]);
+	var consumers = nodes[1:];
+
+	// All consumers are supplied, then the producer stops with a small budget.
+	if (POWER_SYSTEM_Test32_Step == 0)
+	{
+		if (FrameCounter() - POWER_SYSTEM_Test32_Frame < 10)
+			return false;
+		for (var consumer in consumers)
+		{
+			if (!consumer->HasEnoughPower())
+			{
+				Log("%v has no power before the producer stops", consumer);
+				return false;
+			}
+		}
+		GetPowerSystem()->SetPowerBalanceBudget(3);
+		nodes[0]->SetTestProduction(0);
+	}
+	// Only some consumers were switched off so far, the rest waits and is reported as backlog.
+	else if (POWER_SYSTEM_Test32_Step == 1)
+	{
+		var pending = network->GetPendingPowerCallbackCount();
+		if (!network->IsPowerBalanceQueued() || pending == 0 || pending >= GetLength(consumers))
+		{
+			Log("Network %v should wait with some callbacks, but has %d pending callbacks and is queued: %v", network, pending, network->IsPowerBalanceQueued());
+			return false;
+		}
+		var backlog = GetPowerSystem()->GetPowerBalanceBacklog();
+		if (backlog.networks < 1 || backlog.callbacks < pending || backlog.frames <= 0)
+		{
+			Log("The backlog %v does not report the %d pending callbacks of network %v", backlog, pending, network);
+			return false;
+		}
+	}
+	// Eventually all consumers are switched off.
+	else
+	{
+		if (network->IsPowerBalanceQueued())
+			return false;
+		for (var consumer in consumers)
+		{
+			if (consumer->HasEnoughPower())
+			{
+				Log("%v still has power after the backlog was done", consumer);
+				return false;
+			}
+		}
+		if (GetPowerSystem()->GetPowerBalanceBacklog().callbacks != 0)
+		{
+			Log("The backlog still reports callbacks: %v", GetPowerSystem()->GetPowerBalanceBacklog());
+			return false;
+		}
+		return true;
+	}
+	POWER_SYSTEM_Test32_Step++;
+	POWER_SYSTEM_Test32_Frame = FrameCounter();
+	return false;
+}
+
+global func Test32_OnFinished()
+{
+	GetPowerSystem()->SetPowerBalanceBudget(POWER_SYSTEM_BALANCE_BUDGET_DEFAULT);
+	RemoveAll(Find_ID(PowerLine));
+	RemoveAll(Find_ID(Test_PowerNode));
+	return;
+}
+
+
+// The power statistics count the balance updates, the switched nodes and the refreshes.
+static POWER_SYSTEM_Test33_Frame;
+static POWER_SYSTEM_Test33_Step;
+static POWER_SYSTEM_Test33_Nodes;
+
+global func Test33_OnStart(int plr)
+{
+	POWER_SYSTEM_Test33_Frame = FrameCounter();
+	POWER_SYSTEM_Test33_Step = 0;
+
+	// Power nodes: a steady producer, an on-demand producer and a consumer that needs both.
+	POWER_SYSTEM_Test33_Nodes = CreatePowerNodes(3, plr);
+	POWER_SYSTEM_Test33_Nodes[0]->SetProducerPriority(100);
+	POWER_SYSTEM_Test33_Nodes[0]->SetTestProduction(20);
+	POWER_SYSTEM_Test33_Nodes[1]->SetTestSteady(false);
+	POWER_SYSTEM_Test33_Nodes[1]->SetTestProduction(20);
+	POWER_SYSTEM_Test33_Nodes[2]->SetTestDemand(30);
+
+	// Log what the test is about.
+	Log("The power statistics count the balance updates, the producers and consumers that were switched and the refreshes.");
+	return true;
+}
+
+global func Test33_Completed()
+{
+	var consumer = POWER_SYSTEM_Test33_Nodes[2];
+	var network = GetPowerSystem()->GetPowerNetwork(consumer);
+
+	if (FrameCounter() - POWER_SYSTEM_Test33_Frame < 10)
+		return false;
+
+	// Count from here on: the on-demand producer is switched off and on again,
+	// then the consumer is switched off because it needs more than both produce.
+	if (POWER_SYSTEM_Test33_Step == 0)
+	{
+		GetPowerSystem()->ResetPowerStatistics();
+		consumer->SetTestDemand(10);
+	}
+	else if (POWER_SYSTEM_Test33_Step == 1)
+	{
+		consumer->SetTestDemand(35);
+	}
+	else if (POWER_SYSTEM_Test33_Step == 2)
+	{
+		consumer->SetTestDemand(45, 50);
+	}
+	else
+	{
+		var stats = GetPowerSystem()->GetPowerStatistics(network);
+		if (stats.balance_updates != 3 || stats.producer_flips != 2 || stats.consumer_flips != 1 || stats.nodes_visited <= 0)
+		{
+			Log("Network %v counted %d balance updates, %d producer flips, %d consumer flips and %d visited nodes, but should count 3, 2, 1 and some", network, stats.balance_updates, stats.producer_flips, stats.consumer_flips, stats.nodes_visited);
+			return false;
+		}
+		if (stats.refreshes.priority_change != 1)
+		{
+			Log("Network %v counted the refreshes %v, but should count one priority change", network, stats.refreshes);
+			return false;
+		}
+		if (stats.balance_updates_per_second != stats.balance_updates * POWER_SYSTEM_FramesPerSecond / stats.frames)
+		{
+			Log("Network %v counted %d balance updates per second in %d frames, but should count %d", network, stats.balance_updates_per_second, stats.frames, stats.balance_updates * POWER_SYSTEM_FramesPerSecond / stats.frames);
+			return false;
+		}
+		var total = GetPowerSystem()->GetPowerStatistics();
+		if (total.balance_updates < stats.balance_updates || total.producer_flips < stats.producer_flips || total.consumer_flips < stats.consumer_flips)
+		{
+			Log("The counters of all networks %v are lower than the ones of network %v", total, network);
+			return false;
+		}
+		return true;
+	}
+	POWER_SYSTEM_Test33_Step++;
+	POWER_SYSTEM_Test33_Frame = FrameCounter();
+	return false;
+}
+
+global func Test33_OnFinished()
+{
+	RemoveAll(Find_ID(PowerLine));
+	RemoveAll(Find_ID(Test_PowerNode));
+	return;
+}
+
 
 /*-- Helper Functions --*/
 
+// Creates power nodes for a test, connected by power lines into one network.
+global func CreatePowerNodes(int amount, int plr)
+{
+	var nodes = [];
+	for (var i = 0; i < amount; i++)
+	{
+		PushBack(nodes, CreateObjectAbove(Test_PowerNode, 20 + i * 20, 160, plr));
+	}
+	for (var i = 0; i + 1 < amount; i++)
+	{
+		var line = CreateObject(PowerLine, 0, 0, NO_OWNER);
+		line->SetActionTargets(nodes[i], nodes[i + 1]);
+	}
+	PowerLine->RefreshAllLineNetworks();
+	return nodes;
+}
+
+// Returns the network of the power nodes, if they share one with the given totals.
+global func CheckPowerNodeNetwork(array nodes, int available, int demand)
+{
+	var network = GetPowerSystem()->GetPowerNetwork(nodes[0]);
+	for (var node in nodes)
+	{
+		if (GetPowerSystem()->GetPowerNetwork(node) != network || !network->ContainsPowerLink(node))
+		{
+			Log("%v is in %v, but should be in %v", node, GetPowerSystem()->GetPowerNetwork(node), network);
+			return nil;
+		}
+	}
+	if (network->GetPowerAvailable() != available || network->GetPowerConsumptionNeed() != demand)
+	{
+		Log("Network %v has %d units available and a demand of %d, but should have %d and %d", network, network->GetPowerAvailable(), network->GetPowerConsumptionNeed(), available, demand);
+		return nil;
+	}
+	return network;
+}
+
+// The previous way of distributing excess power: one unit per storage and round.
+global func DistributeExcessPowerUnitByUnit(int excess, array lower_bounds, array upper_bounds)
+{
+	var inputs = lower_bounds[:];
+	while (excess > 0)
+	{
+		var total_change = 0;
+		for (var i = 0; i < GetLength(inputs); i++)
+		{
+			if (inputs[i] < upper_bounds[i])
+			{
+				inputs[i]++;
+				excess--;
+				total_change++;
+			}
+		}
+		if (total_change == 0)
+			break;
+	}
+	return inputs;
+}
+
+// Records the calls of a scenario save, so that a test can replay them.
+static const TestScenarioSaveProps = new Global
+{
+	AddCall = func (string name, object target, string function, par0, par1, par2, par3, par4)
+	{
+		PushBack(this.calls, [target, function, par0, par1, par2, par3, par4]);
+		return true;
+	},
+
+	ReplayCalls = func ()
+	{
+		for (var call in this.calls)
+			call[0]->Call(call[1], call[2], call[3], call[4], call[5], call[6]);
+		return;
+	},
+};
+
 global func SetWindFixed(int strength)
 {
 	strength = BoundBy(strength, -100, 100);
@@ -1303,6 +2324,23 @@ global func FxIntFixedWindTimer(object target, proplist effect)
 	return FX_OK;
 }
 
+global func FxIntRecordStoredPowerStart(object target, proplist effect, int temp)
+{
+	if (temp)
+		return FX_OK;
+	effect.stored_power = {};
+	return FX_OK;
+}
+
+global func FxIntRecordStoredPowerTimer(object target, proplist effect)
+{
+	var stored_power = 0;
+	for (var accumulator in FindObjects(Find_ID(Structure_Accumulator)))
+		stored_power += accumulator->GetStoredPower();
+	effect.stored_power[Format("%d", FrameCounter())] = stored_power;
+	return FX_OK;
+}
+
 global func FxIntAlternatingWindTimer(object target, proplist effect, int time)
 {
 	if (((time / effect.Interval) % 2) == 0)